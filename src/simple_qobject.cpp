@@ -1,4 +1,66 @@
 ﻿#include "simple_qobject.h"
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-thread_local base::CEventLoop* base::CEventLoop::s_currentThreadEventLoop = nullptr;
\ No newline at end of file
+
+thread_local base::CEventLoop* base::CEventLoop::s_currentThreadEventLoop = nullptr;
+thread_local base::CEventLoop::PostedTaskCache base::CEventLoop::s_postedTaskCache;
+thread_local base::CEventLoopPool* base::CEventLoopPool::s_currentPool = nullptr;
+thread_local size_t base::CEventLoopPool::s_workerIndex = 0;
+thread_local std::pmr::memory_resource* refl::QObjectArena::s_currentResource = nullptr;
+thread_local refl::PropertyUpdateBatch* refl::PropertyUpdateBatch::s_current = nullptr;
+
+
+std::shared_ptr<const refl::QObjectSnapshot> refl::QObjectSnapshot::open(const char* path) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("cannot open snapshot file!");
+	}
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(kHeaderSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("binary data is not an object snapshot!");
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping) {
+		throw std::runtime_error("cannot map snapshot file!");
+	}
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);// 映射视图会保持文件映射对象有效
+	if (!view) {
+		throw std::runtime_error("cannot map snapshot file!");
+	}
+	std::shared_ptr<const void> owner(view, [](const void* data) { UnmapViewOfFile(data); });
+	return from_memory(view, static_cast<size_t>(size.QuadPart), std::move(owner));
+#else
+	const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::runtime_error("cannot open snapshot file!");
+	}
+	struct stat info {};
+	if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(kHeaderSize)) {
+		::close(fd);
+		throw std::runtime_error("binary data is not an object snapshot!");
+	}
+	const size_t size = static_cast<size_t>(info.st_size);
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);// 映射建立后可以关闭文件
+	if (view == MAP_FAILED) {
+		throw std::runtime_error("cannot map snapshot file!");
+	}
+	std::shared_ptr<const void> owner(view, [size](const void* data) { munmap(const_cast<void*>(data), size); });
+	return from_memory(view, size, std::move(owner));
+#endif
+}
\ No newline at end of file
@@ -1,695 +1,5041 @@
-#pragma once
-
-#include <iostream>
-#include <tuple>
-#include <stdexcept>
-#include <assert.h>
-#include <string_view>
-#include <optional>
-#include <utility> // For std::forward
-#include <unordered_map>
-#include <functional>
-#include <memory>
-#include <any>
-#include <type_traits> // For std::is_invocable
-#include <map>
-
-#include <chrono>
-#include <thread>
-#include <vector>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
-#include <atomic>
-
-namespace refl {
-
-	// ڴֶϢ
-#define REFLECTABLE_PROPERTIES(TypeName, ...)  using CURRENT_TYPE_NAME = TypeName; \
-    static constexpr auto properties_() { return std::make_tuple(__VA_ARGS__); }
-#define REFLECTABLE_MENBER_FUNCS(TypeName, ...) using CURRENT_TYPE_NAME = TypeName; \
-    static constexpr auto member_funcs() { return std::make_tuple(__VA_ARGS__); }
-
-// ڴϢԶֶתΪַ
-#define REFLEC_PROPERTY(Name) refl::internal::__Property<decltype(&CURRENT_TYPE_NAME::Name), &CURRENT_TYPE_NAME::Name>(#Name)
-#define REFLEC_FUNCTION(Func) refl::internal::__Function<decltype(&CURRENT_TYPE_NAME::Func), &CURRENT_TYPE_NAME::Func>(#Func)
-
-	namespace internal {
-		// һԽṹ壬洢ֶƺֵָ
-		template <typename T, T Value>
-		struct __Property {
-			const char* name;
-			constexpr __Property(const char* name) : name(name) {}
-			constexpr T get_value() const { return Value; }
-		};
-		template <typename T, T Value>
-		struct __Function {
-			const char* name;
-			constexpr __Function(const char* name) : name(name) {}
-			constexpr T get_func() const { return Value; }
-		};
-
-		template <typename T, typename Tuple, size_t N = 0>
-		std::any __get_field_value_impl(T& obj, const char* name, const Tuple& tp) {
-			if constexpr (N >= std::tuple_size_v<Tuple>) {
-				return std::any();// Not Found!
-			}
-			else {
-				const auto& prop = std::get<N>(tp);
-				if (std::string_view(prop.name) == name) {
-					return std::any(obj.*(prop.get_value()));
-				}
-				else {
-					return __get_field_value_impl<T, Tuple, N + 1>(obj, name, tp);
-				}
-			}
-		}
-
-		template <typename T, typename Tuple, typename Value, size_t N = 0>
-		std::any __assign_field_value_impl(T& obj, const char* name, const Value& value, const Tuple& tp) {
-			if constexpr (N >= std::tuple_size_v<Tuple>) {
-				return std::any();// Not Found!
-			}
-			else {
-				const auto& prop = std::get<N>(tp);
-				if (std::string_view(prop.name) == name) {
-					if constexpr (std::is_assignable_v<decltype(obj.*(prop.get_value())), Value>) {
-						obj.*(prop.get_value()) = value;
-						return std::any(obj.*(prop.get_value()));
-					}
-					else {
-						assert(false);// ޷ֵ Ͳƥ!!
-						return std::any();
-					}
-				}
-				else {
-					return __assign_field_value_impl<T, Tuple, Value, N + 1>(obj, name, value, tp);
-				}
-			}
-		}
-
-		// Ա:
-		template <bool assert_when_error = true, typename T, typename FuncTuple, size_t N = 0, typename... Args>
-		constexpr std::any __invoke_member_func_impl(T& obj, const char* name, const FuncTuple& tp, Args&&... args) {
-			if constexpr (N >= std::tuple_size_v<FuncTuple>) {
-				assert(!assert_when_error);// ûҵ
-				return std::any();// Not Found!
-			}
-			else {
-				const auto& func = std::get<N>(tp);
-				if (std::string_view(func.name) == name) {
-					if constexpr (std::is_invocable_v<decltype(func.get_func()), T&, Args...>) {
-						if constexpr (std::is_void<decltype(std::invoke(func.get_func(), obj, std::forward<Args>(args)...))>::value) {
-							// ؿգôcase
-							std::invoke(func.get_func(), obj, std::forward<Args>(args)...);
-							return std::any();
-						}
-						else {
-							return std::invoke(func.get_func(), obj, std::forward<Args>(args)...);
-						}
-					}
-					else {
-						assert(!assert_when_error);// òƥ
-						return std::any();
-					}
-				}
-				else {
-					return __invoke_member_func_impl<assert_when_error, T, FuncTuple, N + 1>(obj, name, tp, std::forward<Args>(args)...);
-				}
-			}
-		}
-
-		template <typename T, typename FuncPtr, typename FuncTuple, size_t N = 0>
-		constexpr const char* __get_member_func_name_impl(FuncPtr func_ptr, const FuncTuple& tp) {
-			if constexpr (N >= std::tuple_size_v<FuncTuple>) {
-				return nullptr; // Not Found!
-			}
-			else {
-				const auto& func = std::get<N>(tp);
-				if constexpr (std::is_same< decltype(func.get_func()), FuncPtr >::value) {
-					return func.name;
-				}
-				else {
-					return __get_member_func_name_impl<T, FuncPtr, FuncTuple, N + 1>(func_ptr, tp);
-				}
-			}
-		}
-	}
-
-	template <typename T, size_t N = 0>
-	std::any get_field_value(T* obj, const char* name) {
-		return obj ? __get_field_value_impl(*obj, name, T::properties_()) : std::any();
-	}
-	template <typename T, typename Value>
-	std::any assign_field_value(T* obj, const char* name, const Value& value) {
-		return obj ? __assign_field_value_impl(*obj, name, value, T::properties_()) : std::any();
-	}
-
-	template <typename T, typename... Args>
-	constexpr std::any invoke_member_func(T* obj, const char* name, Args&&... args) {
-		constexpr auto funcs = T::member_funcs();
-		return obj ? __invoke_member_func_impl(obj, name, funcs, std::forward<Args>(args)...) : std::any();
-	}
-
-	template <typename T, typename... Args>
-	constexpr std::any invoke_member_func_safe(T* obj, const char* name, Args&&... args) {
-		constexpr auto funcs = T::member_funcs();
-		return obj ? internal::__invoke_member_func_impl<true>(obj, name, funcs, std::forward<Args>(args)...) : std::any();
-	}
-
-
-	template <typename T, typename FuncPtr>
-	constexpr const char* get_member_func_name(FuncPtr func_ptr) {
-		constexpr auto funcs = T::member_funcs();
-		return internal::__get_member_func_name_impl<T, FuncPtr>(func_ptr, funcs);
-	}
-
-
-	// ģڱȡϢ
-	template <typename T>
-	struct For {
-		static_assert(std::is_class_v<T>, "Reflector requires a class type.");
-
-		// ֶ
-		template <typename Func>
-		static void for_each_propertie_name(Func&& func) {
-			constexpr auto props = T::properties_();
-			std::apply([&](auto... x) {
-				((func(x.name)), ...);
-				}, props);
-		}
-
-		// ֵֶ
-		template <typename Func>
-		static void for_each_propertie_value(T* obj, Func&& func) {
-			constexpr auto props = T::properties_();
-			std::apply([&](auto... x) {
-				((func(x.name, obj->*(x.get_value()))), ...);
-				}, props);
-		}
-
-		// к
-		template <typename Func>
-		static void for_each_member_func_name(Func&& func) {
-			constexpr auto props = T::member_funcs();
-			std::apply([&](auto... x) {
-				((func(x.name)), ...);
-				}, props);
-		}
-	};
-
-	// 涼Ǿ̬书ܣǶ̬Ƶִ֧룺
-
-	// IReflectableṩ̬书֧ܵ
-	class IReflectable : public std::enable_shared_from_this<IReflectable> {
-	public:
-		virtual ~IReflectable() = default;
-		virtual std::string_view get_type_name() const = 0;
-
-		virtual std::any get_field_value_by_name(const char* name) const = 0;
-
-		virtual std::any invoke_member_func_by_name(const char* name) = 0;
-		virtual std::any invoke_member_func_by_name(const char* name, std::any param1) = 0;
-		virtual std::any invoke_member_func_by_name(const char* name, std::any param1, std::any param2) = 0;
-		virtual std::any invoke_member_func_by_name(const char* name, std::any param1, std::any param2, std::any param3) = 0;
-		virtual std::any invoke_member_func_by_name(const char* name, std::any param1, std::any param2, std::any param3, std::any param4) = 0;
-		// ӣС֧4ĵá
-	};
-
-	namespace internal {
-		// עṤ
-		class TypeRegistry {
-		public:
-			using CreatorFunc = std::function<std::shared_ptr<IReflectable>()>;
-
-			static TypeRegistry& instance() {
-				static TypeRegistry registry;
-				return registry;
-			}
-
-			void register_type(const std::string_view type_name, CreatorFunc creator) {
-				creators_[type_name] = std::move(creator);
-			}
-
-			std::shared_ptr<IReflectable> create(const std::string_view type_name) {
-				if (auto it = creators_.find(type_name); it != creators_.end()) {
-					return it->second();
-				}
-				return nullptr;
-			}
-
-		private:
-			std::unordered_map<std::string_view, CreatorFunc> creators_;
-		};
-
-		// עϢĺ
-#define DECL_DYNAMIC_REFLECTABLE(TypeName) \
-    friend class refl::internal::TypeRegistryEntry<TypeName>; \
-    static std::string_view static_type_name() { return #TypeName; } \
-    virtual std::string_view get_type_name() const override { return static_type_name(); } \
-    static std::shared_ptr<::refl::IReflectable> create_instance() { return std::make_shared<TypeName>(); } \
-    static const bool is_registered; \
-    std::any get_field_value_by_name(const char* name) const override { \
-        return refl::get_field_value(this, name); \
-    } \
-    std::any invoke_member_func_by_name(const char* name) override { \
-        return refl::invoke_member_func(static_cast<TypeName*>(this), name); \
-    }\
-	std::any invoke_member_func_by_name(const char* name, std::any param1) override { \
-		return refl::invoke_member_func(static_cast<TypeName*>(this), name, param1); \
-	}\
-	std::any invoke_member_func_by_name(const char* name, std::any param1, std::any param2) override { \
-		return refl::invoke_member_func(static_cast<TypeName*>(this), name, param1, param2); \
-	}\
-	std::any invoke_member_func_by_name(const char* name, std::any param1, std::any param2, std::any param3) override { \
-		return refl::invoke_member_func(static_cast<TypeName*>(this), name, param1, param2, param3); \
-	}\
-	std::any invoke_member_func_by_name(const char* name, std::any param1, std::any param2, std::any param3, std::any param4) override { \
-		return refl::invoke_member_func(static_cast<TypeName*>(this), name, param1, param2, param3, param4); \
-	}\
-
-	// ھ̬ע͵ĸ
-		template <typename T>
-		class TypeRegistryEntry {
-		public:
-			TypeRegistryEntry() {
-				::refl::internal::TypeRegistry::instance().register_type(T::static_type_name(), &T::create_instance);
-			}
-		};
-
-		// ΪÿͶעκҪcppС
-#define REGEDIT_DYNAMIC_REFLECTABLE(TypeName) \
-    const bool TypeName::is_registered = [] { \
-        static ::refl::internal::TypeRegistryEntry<TypeName> entry; \
-        return true; \
-    }();
-
-	}//namespace dynamic
-
-
-	//źţṩһͬķźšǺбʾ
-	/*	void x_value_modified(int param) {
-		IMPL_SIGNAL(param);
-	}*/
-#define REFLEC_IMPL_SIGNAL(...) raw_emit_signal_impl(__func__ , __VA_ARGS__)
-
-	// CObjectIReflectableĻϣṩźŲ۹֧ܵ
-	class CObject :
-		public refl::IReflectable {
-	private:
-		// ź۵ӳ䣬źƣֵһۺϢ
-		using connections_list_type = std::list<std::tuple< std::weak_ptr<IReflectable>, std::string>>;
-		using connections_type = std::unordered_map<std::string, connections_list_type>;
-		connections_type connections_;
-
-	public:
-		template<typename... Args>
-		void raw_emit_signal_impl(const char* signal_name, Args&&... args) {
-			auto it = connections_.find(signal_name);
-			if (it != connections_.end()) {
-				auto& slots = it->second; // ȡϢб
-				bool has_invalid_slot = false;
-				for (const auto& slot_info : slots) {
-					auto ptr = std::get<0>(slot_info).lock(); // 
-					if (ptr) {
-						ptr->invoke_member_func_by_name(std::get<1>(slot_info).c_str(), std::forward<Args>(args)...);
-					}
-					else {
-						has_invalid_slot = true;
-					}
-				}
-				if (has_invalid_slot) {
-					//ЧִһƳ
-					auto remove_it = std::remove_if(slots.begin(), slots.end(),
-						[](const auto& slot_info) {
-							return std::get<0>(slot_info).expired(); // ǷʧЧ
-						});
-					slots.erase(remove_it, slots.end());
-				}
-			}
-			else {/*ûҵźţҪҪassert*/ }
-		}
-
-		auto connect(const char* signal_name, refl::CObject* slot_instance, const char* slot_member_func_name) {
-			if (!slot_instance || !signal_name || !slot_member_func_name) {
-				throw std::runtime_error("param is null!");
-			}
-			assert(slot_instance->weak_from_this().lock());//targetͨmake_share죡ΪҪ
-
-			std::string str_signal_name(signal_name);
-			auto itMap = connections_.find(str_signal_name);
-			if (itMap != connections_.end()) {
-				itMap->second.emplace_back(slot_instance->weak_from_this(), slot_member_func_name);//ĩβΪ--end()ָʾ
-				return std::make_optional(std::make_tuple(this, itMap, --itMap->second.end()));
-			}
-			else {
-				// ûҵԪصmapУȡ
-				auto emplace_result = connections_.emplace(std::make_pair(std::move(str_signal_name), connections_list_type()));
-				itMap = emplace_result.first;
-				itMap->second.emplace_back(slot_instance->weak_from_this(), slot_member_func_name);
-				return std::make_optional(std::make_tuple(this, itMap, --itMap->second.end()));
-			}
-		}
-		template <typename SlotClass>
-		auto connect(const char* signal_name, std::shared_ptr<SlotClass> slot_instance, const char* slot_member_func_name) {
-			return connect(signal_name, slot_instance.get(), slot_member_func_name);
-		}
-
-		template <typename SignalClass, typename SignalType, typename SlotClass, typename SlotType>
-		auto connect(SignalType SignalClass::* signal, SlotClass* slot_instance, SlotType SlotClass::* slot) {
-			const char* signal_name = get_member_func_name<SignalClass>(signal);
-			const char* slot_name = get_member_func_name<SlotClass>(slot);
-			if (signal_name && slot_name) {
-				return connect(signal_name, static_cast<CObject*>(slot_instance), slot_name);
-			}
-			throw std::runtime_error("signal name or slot_name is not found!");
-		}
-		template <typename SignalClass, typename SignalType, typename SlotClass, typename SlotType>
-		auto connect(SignalType SignalClass::* signal, std::shared_ptr<SlotClass>& slot_instance, SlotType SlotClass::* slot) {
-			return connect(signal, slot_instance.get(), slot);
-		}
-
-		template <typename T>
-		bool disconnect(T connection) {
-			//TǸͣstd::make_optional(std::make_tuple(this, itMap, it)); Tڸӣֱģ
-			if (!connection) {
-				return false;
-			}
-			auto& tuple = connection.value();
-			if (std::get<0>(tuple) != this) {
-				return false;//ҵconnectionѽ
-			}
-			std::get<1>(tuple)->second.erase(std::get<2>(tuple));
-			return true;
-		}
-	};
-
-	// QObjectCObjectĻϣṩӹϵ̬Ե֧
-	class QObject : public CObject {
-	private:
-		std::string objectName_;
-		std::weak_ptr<refl::IReflectable> parent_;
-		std::unordered_map<std::string, std::any> properties_;
-		std::list<std::shared_ptr<refl::IReflectable>> children_;
-	public:
-		void setObjectName(const char* name) {
-			objectName_ = name;
-		}
-		const std::string& getObjectName() {
-			return objectName_;
-		}
-
-		void setParent(QObject* newParent) {
-			if (auto oldParent = dynamic_cast<QObject*>(parent_.lock().get())) {
-				auto it = std::find_if(oldParent->children_.begin(), oldParent->children_.end(),
-					[this](const auto& child) { return child.get() == this; });
-				if (it != oldParent->children_.end()) {
-					oldParent->children_.erase(it);
-				}
-			}
-			if (newParent) {
-				parent_ = newParent->weak_from_this();
-				newParent->children_.push_back(shared_from_this());
-			}
-			else {
-				parent_.reset();
-			}
-		}
-		template <typename T>
-		void setParent(std::shared_ptr<T> newParent) {
-			setParent(newParent.get());
-		}
-
-		void removeChild(CObject* child) {
-			auto ch = static_cast<refl::IReflectable*>(child);
-			auto it = std::find_if(children_.begin(), children_.end(),
-				[this, ch](const auto& child) { return child.get() == ch; });
-			if (it != children_.end()) {
-				children_.erase(it);
-			}
-		}
-		CObject* findChild(const char* name) {
-			for (auto child : children_) {
-				QObject* qChild = dynamic_cast<QObject*>(child.get());
-				if (qChild && qChild->objectName_ == name) {
-					return qChild;
-				}
-			}
-			return nullptr;
-		}
-		CObject* findChildRecursively(const char* name) {
-			for (auto child : children_) {
-				QObject* qChild = dynamic_cast<QObject*>(child.get());
-				if (qChild) {
-					if (qChild->objectName_ == name) {
-						return qChild;
-					}
-					CObject* found = qChild->findChildRecursively(name);
-					if (found) {
-						return found;
-					}
-				}
-			}
-			return nullptr;
-		}
-
-		const std::any& getProperty(const char* name) {
-			return properties_[name];
-		}
-		template<typename T>
-		const T* getProperty(const char* name) {
-			try {
-				return &std::any_cast<const T&>(properties_[name]);
-			}
-			catch (...) {
-				return nullptr;
-			}
-		}
-		void setProperty(const char* name, const std::any& value) {
-			properties_[name] = value;
-		}
-	};
-
-}// namespace refl
-
-
-namespace base {
-
-	// CEventLoopṩ¼ѭ֧
-	class CEventLoop {
-	public:
-		using Clock = std::chrono::steady_clock;
-		using TimePoint = Clock::time_point;
-		using Duration = Clock::duration;
-		using Handler = std::function<void()>;
-		using CancelHandle = std::shared_ptr<bool>;
-
-		struct TaskEventInfo {
-			TimePoint time;
-			Handler handler;
-			Duration interval;
-			bool repeat = false;
-			std::shared_ptr<bool> active;
-			bool operator<(const TaskEventInfo& other) const {
-				return time > other.time;
-			}
-		};
-		class IEventLoopHost {
-		public:
-			CEventLoop* eventLoop = nullptr;
-			virtual ~IEventLoopHost() = default;
-			virtual void onPostTask() = 0;
-			virtual void onWaitForTask(std::condition_variable& cond, std::unique_lock<std::mutex>& locker) = 0;
-			virtual void onEvent(TaskEventInfo& event) = 0;
-			virtual void onWaitForRun(std::condition_variable& cond, std::unique_lock<std::mutex>& locker, const TimePoint& timePoint) = 0;
-		};
-	private:
-		IEventLoopHost* host = nullptr;
-		std::priority_queue<TaskEventInfo> tasks_;
-		std::mutex mutex_;
-		std::condition_variable cond_;
-		std::atomic<bool> running_{ true };
-
-		static thread_local CEventLoop* s_currentThreadEventLoop;
-	public:
-		CEventLoop(IEventLoopHost* host = nullptr) {
-			this->host = host;
-			host->eventLoop = this;
-			if (s_currentThreadEventLoop == nullptr) {
-				s_currentThreadEventLoop = this;
-			}
-		}
-		~CEventLoop() {
-			if (s_currentThreadEventLoop == this) {
-				s_currentThreadEventLoop = nullptr;
-			}
-		}
-
-		CEventLoop* currentThreadEventLoop() {
-			return s_currentThreadEventLoop;
-		}
-
-		void post(Handler handler, Duration delay = Duration::zero()) {
-			std::unique_lock<std::mutex> lock(mutex_);
-			tasks_.push({ Clock::now() + delay, std::move(handler) });
-			cond_.notify_one();
-			if (host) {
-				host->onPostTask();
-			}
-		}
-
-		//ȡpost
-		CancelHandle postCancellable(Handler handler, Duration delay = Duration::zero()) {
-			std::unique_lock<std::mutex> lock(mutex_);
-			TaskEventInfo timedHandler{ Clock::now() + delay, std::move(handler), {}, false, std::make_shared<bool>(true) };
-			tasks_.push(timedHandler);
-			cond_.notify_one();
-			if (host) {
-				host->onPostTask();
-			}
-			return timedHandler.active;
-		}
-
-		// ֹͣһԵĶʱ
-		void cancelPostTask(CancelHandle& active) {
-			if (active) { *active = false; }
-		}
-
-		// һԵĶʱ
-		CancelHandle startTimer(Handler handler, Duration interval) {
-			std::unique_lock<std::mutex> lock(mutex_);
-			TaskEventInfo timedHandler{ Clock::now() + interval, std::move(handler), interval, true, std::make_shared<bool>(true) };
-			tasks_.push(timedHandler);
-			cond_.notify_one();
-			return timedHandler.active;
-		}
-
-		// ֹͣһԵĶʱ
-		void stopTimer(CancelHandle& active) {
-			if (active) { *active = false; }
-		}
-
-		void run() {
-			while (running_) {
-				std::unique_lock<std::mutex> lock(mutex_);
-				if (tasks_.empty()) {
-					if (host) {
-						host->onWaitForTask(cond_, lock);
-					}
-					else {
-						cond_.wait(lock, [this] { return !tasks_.empty() || !running_; });
-					}
-				}
-				if (!running_) {
-					break;
-				}
-				while (!tasks_.empty() && tasks_.top().time <= Clock::now()) {
-					auto task = tasks_.top();
-					tasks_.pop();
-					lock.unlock();
-					bool isActive = task.active.get() ? (*task.active.get()) : true;
-					if (isActive) {
-						if (host) {
-							host->onEvent(task);
-						}
-						else {
-							task.handler();
-						}
-						lock.lock();
-
-						if (task.repeat) { // Ǹtimer,һδʱŻȥ
-							task.time = Clock::now() + task.interval;
-							tasks_.push(task);
-						}
-					}
-					else {
-						lock.lock();
-					}
-				}
-
-				if (!tasks_.empty()) {
-					if (host) {
-						host->onWaitForRun(cond_, lock, tasks_.top().time);
-					}
-					else {
-						cond_.wait_until(lock, tasks_.top().time);
-					}
-				}
-			}
-		}
-
-		void stop() {
-			running_ = false;
-			cond_.notify_all();
-		}
-
-	};
-
-}// namespace base
-
-
-#ifdef _WIN32
-#include <Windows.h>
-class CWindowsEventLoopHost : public base::CEventLoop::IEventLoopHost {
-	static constexpr UINT WM_WAKEUP = WM_USER + 15151515;
-	UINT_PTR timerID_ = 0;
-
-public:
-	~CWindowsEventLoopHost() {
-		if (timerID_) {
-			KillTimer(NULL, timerID_);
-		}
-	}
-
-	void onPostTask() override {
-		PostThreadMessage(GetCurrentThreadId(), WM_WAKEUP, 0, 0);
-	}
-
-	void onWaitForTask(std::condition_variable& cond, std::unique_lock<std::mutex>& locker) override {
-		MSG msg;
-		while (GetMessage(&msg, NULL, 0, 0)) {
-			if (handleWindowsMessage(msg)) {
-				break;
-			}
-			if (cond.wait_for(locker, std::chrono::milliseconds(0), [] { return true; })) {
-				break;
-			}
-		}
-	}
-
-	void onEvent(base::CEventLoop::TaskEventInfo& event) override {
-		event.handler();
-	}
-
-	void onWaitForRun(std::condition_variable& cond, std::unique_lock<std::mutex>& locker, const std::chrono::steady_clock::time_point& timePoint) override {
-		auto now = std::chrono::steady_clock::now();
-		if (now < timePoint) {
-			auto delay_ms = std::chrono::duration_cast<std::chrono::milliseconds>(timePoint - now).count();
-			timerID_ = SetTimer(NULL, 0, (UINT)delay_ms, NULL);//ͨtimer¼
-			MSG msg;
-			while (GetMessage(&msg, NULL, 0, 0)) {
-				if (handleWindowsMessage(msg)) {
-					break;
-				}
-			}
-		}
-	}
-
-	bool handleWindowsMessage(MSG& msg) {
-		if (msg.message == WM_QUIT) {
-			if (this->eventLoop) {
-				this->eventLoop->stop();//˳Ϣѭ
-			}
-			return true;
-		}
-		if (msg.message == WM_TIMER && msg.wParam == timerID_) {
-			KillTimer(NULL, timerID_);
-			timerID_ = 0;
-			return true; // Timer event occurred
-		}
-		TranslateMessage(&msg);
-		DispatchMessage(&msg);
-		return false;
-	}
-};
-#endif // _WIN32
\ No newline at end of file
+#pragma once
+
+#include <iostream>
+#include <tuple>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <assert.h>
+#include <string_view>
+#include <optional>
+#include <utility> // For std::forward
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <any>
+#include <type_traits> // For std::is_invocable
+#include <map>
+#include <list>
+#include <algorithm>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <queue>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <typeinfo>
+
+// 用C++20编译时提供协程支持：co_await loop.sleep(d)、loop.switch_to()、obj->next_signal("x")
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#define SIMPLE_QOBJECT_HAS_COROUTINES 1
+#else
+#define SIMPLE_QOBJECT_HAS_COROUTINES 0
+#endif
+
+namespace base {
+	class CEventLoop;
+
+	// 事件循环的任务：只能移动的可调用对象，不超过kInlineSize字节的闭包直接存在对象内，不分配堆内存
+	class CTask {
+	public:
+		static constexpr size_t kInlineSize = 48;
+
+		CTask() noexcept = default;
+		CTask(std::nullptr_t) noexcept {}
+
+		template <typename Func, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, CTask> &&
+			std::is_invocable_v<std::decay_t<Func>&>>>
+		CTask(Func&& func) {
+			using F = std::decay_t<Func>;
+			if constexpr (fitsInline<F>()) {
+				new (storage_) F(std::forward<Func>(func));
+				ops_ = &inlineOps<F>;
+			}
+			else {
+				*reinterpret_cast<F**>(storage_) = new F(std::forward<Func>(func));
+				ops_ = &heapOps<F>;
+			}
+		}
+
+		CTask(CTask&& other) noexcept {
+			moveFrom(other);
+		}
+		CTask& operator=(CTask&& other) noexcept {
+			if (this != &other) {
+				reset();
+				moveFrom(other);
+			}
+			return *this;
+		}
+		CTask& operator=(std::nullptr_t) noexcept {
+			reset();
+			return *this;
+		}
+		CTask(const CTask&) = delete;
+		CTask& operator=(const CTask&) = delete;
+		~CTask() {
+			reset();
+		}
+
+		explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+		void operator()() {
+			assert(ops_ && "call an empty CTask");
+			ops_->invoke(storage_);
+		}
+
+	private:
+		// move和destroy为空表示可以直接按字节拷贝、不需要析构，常见的只捕获指针和引用的lambda都是这样
+		struct Ops {
+			void (*invoke)(void* storage);
+			void (*move)(void* to, void* from) noexcept;// 移动到to并析构from
+			void (*destroy)(void* storage) noexcept;
+		};
+
+		template <typename F>
+		static constexpr bool fitsInline() {
+			return sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+		}
+
+		template <typename F>
+		static void invokeInline(void* storage) {
+			(*std::launder(reinterpret_cast<F*>(storage)))();
+		}
+		template <typename F>
+		static void moveInline(void* to, void* from) noexcept {
+			F* source = std::launder(reinterpret_cast<F*>(from));
+			new (to) F(std::move(*source));
+			source->~F();
+		}
+		template <typename F>
+		static void destroyInline(void* storage) noexcept {
+			std::launder(reinterpret_cast<F*>(storage))->~F();
+		}
+
+		template <typename F>
+		static inline const Ops inlineOps = {
+			&invokeInline<F>,
+			std::is_trivially_copyable_v<F> ? nullptr : &moveInline<F>,
+			std::is_trivially_destructible_v<F> ? nullptr : &destroyInline<F>
+		};
+
+		template <typename F>
+		static inline const Ops heapOps = {
+			[](void* storage) { (**reinterpret_cast<F**>(storage))(); },
+			nullptr,// 只保存了指针
+			[](void* storage) noexcept { delete *reinterpret_cast<F**>(storage); }
+		};
+
+		void moveFrom(CTask& other) noexcept {
+			if (other.ops_) {
+				if (other.ops_->move) {
+					other.ops_->move(storage_, other.storage_);
+				}
+				else {
+					std::memcpy(storage_, other.storage_, kInlineSize);
+				}
+				ops_ = other.ops_;
+				other.ops_ = nullptr;
+			}
+		}
+
+		void reset() noexcept {
+			if (ops_) {
+				const Ops* ops = ops_;
+				ops_ = nullptr;
+				if (ops->destroy) {
+					ops->destroy(storage_);
+				}
+			}
+		}
+
+		alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+		const Ops* ops_ = nullptr;
+	};
+}
+
+namespace refl {
+
+	// 按名字查找属性或成员函数失败时返回的下标
+	inline constexpr size_t invalid_index = static_cast<size_t>(-1);
+
+	class CObject;
+	class IReflectable;
+	class BinaryWriter;
+	class BinaryReader;
+
+	// 这个宏用于创建字段信息
+#define REFLECTABLE_PROPERTIES(TypeName, ...) \
+    static constexpr auto properties_() { using CURRENT_TYPE_NAME [[maybe_unused]] = TypeName; return std::make_tuple(__VA_ARGS__); }
+#define REFLECTABLE_MENBER_FUNCS(TypeName, ...) \
+    static constexpr auto member_funcs() { using CURRENT_TYPE_NAME [[maybe_unused]] = TypeName; return std::make_tuple(__VA_ARGS__); }
+
+// 这个宏用于创建属性信息，并自动将字段名转换为字符串
+#define REFLEC_PROPERTY(Name) refl::internal::__Property<decltype(&CURRENT_TYPE_NAME::Name), &CURRENT_TYPE_NAME::Name>(#Name)
+#define REFLEC_FUNCTION(Func) refl::internal::__Function<decltype(&CURRENT_TYPE_NAME::Func), &CURRENT_TYPE_NAME::Func>(#Func)
+
+	namespace internal {
+		// 定义一个属性结构体，存储字段名称和值的指针
+		template <typename T, T Value>
+		struct __Property {
+			const char* name;
+			constexpr __Property(const char* name) : name(name) {}
+			constexpr T get_value() const { return Value; }
+		};
+		template <typename T, T Value>
+		struct __Function {
+			const char* name;
+			constexpr __Function(const char* name) : name(name) {}
+			constexpr T get_func() const { return Value; }
+		};
+
+		// 编译期字符串哈希(FNV-1a)，编译期建表和运行期查找使用同一个函数
+		constexpr uint32_t __hash_name(const char* name) {
+			uint32_t hash = 2166136261u;
+			while (*name) {
+				hash ^= static_cast<unsigned char>(*name++);
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		constexpr bool __name_equal(const char* a, const char* b) {
+			while (*a && *a == *b) {
+				++a; ++b;
+			}
+			return *a == *b;
+		}
+
+		// 编译期生成的名字->下标哈希表(开放寻址，线性探测)，按名字查找平均O(1)
+		template <size_t N>
+		struct __NameTable {
+			static constexpr size_t npos = N;
+			static constexpr size_t capacity = [] {
+				size_t cap = 1;
+				while (cap < N * 2) { cap <<= 1; }
+				return cap;
+			}();
+
+			std::array<const char*, N> names{};
+			std::array<uint32_t, N> hashes{};
+			std::array<uint32_t, capacity> slots{};// 存放下标+1，0表示空槽
+
+			constexpr __NameTable(const std::array<const char*, N>& list) {
+				for (size_t i = 0; i < N; ++i) {
+					names[i] = list[i];
+					hashes[i] = __hash_name(list[i]);
+					size_t pos = hashes[i] & (capacity - 1);
+					while (slots[pos] != 0) {
+						pos = (pos + 1) & (capacity - 1);
+					}
+					slots[pos] = static_cast<uint32_t>(i + 1);
+				}
+			}
+
+			// 找不到返回npos
+			constexpr size_t find(const char* name) const {
+				if (!name) {
+					return npos;
+				}
+				const uint32_t hash = __hash_name(name);
+				for (size_t pos = hash & (capacity - 1); slots[pos] != 0; pos = (pos + 1) & (capacity - 1)) {
+					const size_t index = slots[pos] - 1;
+					if (hashes[index] == hash && __name_equal(names[index], name)) {
+						return index;
+					}
+				}
+				return npos;
+			}
+		};
+
+		template <typename Tuple>
+		constexpr auto __make_name_table(const Tuple& tp) {
+			constexpr size_t N = std::tuple_size_v<Tuple>;
+			return __NameTable<N>(std::apply([](const auto&... x) {
+				return std::array<const char*, N>{ x.name... };
+				}, tp));
+		}
+
+		// 每个类型的属性表和函数表，只在编译期生成一次
+		template <typename T>
+		struct __PropertyTable {
+			static constexpr auto value = __make_name_table(std::remove_cv_t<T>::properties_());
+		};
+		template <typename T>
+		struct __MemberFuncTable {
+			static constexpr auto value = __make_name_table(std::remove_cv_t<T>::member_funcs());
+		};
+
+		// 以下是按下标分发的跳转表，查表得到下标后直接调用对应的thunk，不再逐个比较名字
+		template <typename T, size_t I>
+		std::any __get_field_value_thunk(T& obj) {
+			constexpr auto prop = std::get<I>(std::remove_cv_t<T>::properties_());
+			return std::any(obj.*(prop.get_value()));
+		}
+
+		template <typename T, size_t... I>
+		constexpr auto __make_get_field_value_jump_table(std::index_sequence<I...>) {
+			return std::array<std::any(*)(T&), sizeof...(I)>{ &__get_field_value_thunk<T, I>... };
+		}
+
+		template <typename T>
+		struct __GetFieldValueJumpTable {
+			static constexpr auto value = __make_get_field_value_jump_table<T>(
+				std::make_index_sequence<std::tuple_size_v<decltype(std::remove_cv_t<T>::properties_())>>());
+		};
+
+		// 只对标量和字符串判断新旧值是否相等，其他类型(比如元素不支持==的容器)总是当作有变化
+		template <typename Field, typename Value, typename = void>
+		struct __is_cheaply_comparable : std::false_type {};
+		template <typename Field, typename Value>
+		struct __is_cheaply_comparable<Field, Value, std::void_t<decltype(std::declval<const Field&>() == std::declval<const Value&>())>>
+			: std::bool_constant<std::is_scalar_v<Field> || std::is_same_v<Field, std::string> || std::is_same_v<Field, std::string_view>> {};
+
+		// CObject的派生类在属性赋了不同的值之后发出变化通知
+		template <typename T>
+		void __notify_property_changed(T& obj, const char* name) {
+			if constexpr (std::is_base_of_v<CObject, T>) {
+				obj.notify_property_changed(name);
+			}
+		}
+
+		template <typename T, typename Field, typename Value>
+		std::any __assign_and_notify(T& obj, Field& field, const Value& value, const char* name) {
+			if constexpr (__is_cheaply_comparable<Field, Value>::value) {
+				if (field == value) {
+					return std::any(field);
+				}
+			}
+			field = value;
+			__notify_property_changed(obj, name);
+			return std::any(field);
+		}
+
+		template <typename T, typename Value, size_t I>
+		std::any __assign_field_value_thunk(T& obj, const Value& value) {
+			constexpr auto prop = std::get<I>(std::remove_cv_t<T>::properties_());
+			if constexpr (std::is_assignable_v<decltype(obj.*(prop.get_value())), Value>) {
+				return __assign_and_notify(obj, obj.*(prop.get_value()), value, prop.name);
+			}
+			else {
+				assert(false);// 无法赋值 类型不匹配!!
+				return std::any();
+			}
+		}
+
+		template <typename T, typename Value, size_t... I>
+		constexpr auto __make_assign_field_value_jump_table(std::index_sequence<I...>) {
+			return std::array<std::any(*)(T&, const Value&), sizeof...(I)>{ &__assign_field_value_thunk<T, Value, I>... };
+		}
+
+		template <typename T, typename Value>
+		struct __AssignFieldValueJumpTable {
+			static constexpr auto value = __make_assign_field_value_jump_table<T, Value>(
+				std::make_index_sequence<std::tuple_size_v<decltype(std::remove_cv_t<T>::properties_())>>());
+		};
+
+		// 成员函数调用相关:
+		template <bool assert_when_error, typename T, size_t I, typename... Args>
+		std::any __invoke_member_func_thunk(T& obj, Args&&... args) {
+			constexpr auto func = std::get<I>(std::remove_cv_t<T>::member_funcs());
+			if constexpr (std::is_invocable_v<decltype(func.get_func()), T&, Args...>) {
+				if constexpr (std::is_void<decltype(std::invoke(func.get_func(), obj, std::forward<Args>(args)...))>::value) {
+					// 如果函数返回空，那么兼容这种case
+					std::invoke(func.get_func(), obj, std::forward<Args>(args)...);
+					return std::any();
+				}
+				else {
+					return std::invoke(func.get_func(), obj, std::forward<Args>(args)...);
+				}
+			}
+			else {
+				assert(!assert_when_error);// 调用参数不匹配
+				return std::any();
+			}
+		}
+
+		template <bool assert_when_error, typename T, typename... Args, size_t... I>
+		constexpr auto __make_invoke_member_func_jump_table(std::index_sequence<I...>) {
+			return std::array<std::any(*)(T&, Args&&...), sizeof...(I)>{ &__invoke_member_func_thunk<assert_when_error, T, I, Args...>... };
+		}
+
+		template <bool assert_when_error, typename T, typename... Args>
+		struct __InvokeMemberFuncJumpTable {
+			static constexpr auto value = __make_invoke_member_func_jump_table<assert_when_error, T, Args...>(
+				std::make_index_sequence<std::tuple_size_v<decltype(std::remove_cv_t<T>::member_funcs())>>());
+		};
+
+		template <typename T>
+		std::any __get_field_value_impl(T& obj, const char* name) {
+			const size_t index = __PropertyTable<T>::value.find(name);
+			if (index == __PropertyTable<T>::value.npos) {
+				return std::any();// Not Found!
+			}
+			return __GetFieldValueJumpTable<T>::value[index](obj);
+		}
+
+		template <typename T, typename Value>
+		std::any __assign_field_value_impl(T& obj, const char* name, const Value& value) {
+			const size_t index = __PropertyTable<T>::value.find(name);
+			if (index == __PropertyTable<T>::value.npos) {
+				return std::any();// Not Found!
+			}
+			return __AssignFieldValueJumpTable<T, Value>::value[index](obj, value);
+		}
+
+		template <bool assert_when_error = true, typename T, typename... Args>
+		std::any __invoke_member_func_impl(T& obj, const char* name, Args&&... args) {
+			const size_t index = __MemberFuncTable<T>::value.find(name);
+			if (index == __MemberFuncTable<T>::value.npos) {
+				assert(!assert_when_error);// 没找到！
+				return std::any();// Not Found!
+			}
+			return __InvokeMemberFuncJumpTable<assert_when_error, T, Args...>::value[index](obj, std::forward<Args>(args)...);
+		}
+
+		// 不经过std::any的字段访问：取字段地址，或者把字段左值直接交给访问者
+		template <typename FieldType, typename T, size_t I>
+		void* __get_field_ref_thunk(T& obj) {
+			constexpr auto prop = std::get<I>(std::remove_cv_t<T>::properties_());
+			auto& field = obj.*(prop.get_value());
+			if constexpr (std::is_same_v<std::remove_cv_t<std::remove_reference_t<decltype(field)>>, FieldType>) {
+				return const_cast<void*>(static_cast<const void*>(&field));
+			}
+			else {
+				return nullptr;// 类型不匹配
+			}
+		}
+
+		template <typename FieldType, typename T, size_t... I>
+		constexpr auto __make_get_field_ref_jump_table(std::index_sequence<I...>) {
+			return std::array<void* (*)(T&), sizeof...(I)>{ &__get_field_ref_thunk<FieldType, T, I>... };
+		}
+
+		template <typename FieldType, typename T>
+		void* __get_field_ref_impl(T& obj, const char* name) {
+			static constexpr auto table = __make_get_field_ref_jump_table<FieldType, T>(
+				std::make_index_sequence<std::tuple_size_v<decltype(std::remove_cv_t<T>::properties_())>>());
+			const size_t index = __PropertyTable<T>::value.find(name);
+			return index < table.size() ? table[index](obj) : nullptr;
+		}
+
+		template <typename T, typename Func, size_t I>
+		void __visit_field_thunk(T& obj, Func& func) {
+			constexpr auto prop = std::get<I>(std::remove_cv_t<T>::properties_());
+			func(obj.*(prop.get_value()));
+		}
+
+		template <typename T, typename Func, size_t... I>
+		constexpr auto __make_visit_field_jump_table(std::index_sequence<I...>) {
+			return std::array<void(*)(T&, Func&), sizeof...(I)>{ &__visit_field_thunk<T, Func, I>... };
+		}
+
+		template <typename T, typename Func>
+		bool __visit_field_impl(T& obj, const char* name, Func& func) {
+			static constexpr auto table = __make_visit_field_jump_table<T, Func>(
+				std::make_index_sequence<std::tuple_size_v<decltype(std::remove_cv_t<T>::properties_())>>());
+			const size_t index = __PropertyTable<T>::value.find(name);
+			if (index >= table.size()) {
+				return false;// Not Found!
+			}
+			table[index](obj, func);
+			return true;
+		}
+
+		// 通过std::any赋值时要求类型完全一致
+		template <typename T, size_t I>
+		std::any __assign_field_any_thunk(T& obj, const std::any& value) {
+			constexpr auto prop = std::get<I>(std::remove_cv_t<T>::properties_());
+			using FieldType = std::remove_reference_t<decltype(obj.*(prop.get_value()))>;
+			if (auto typed_value = std::any_cast<FieldType>(&value)) {
+				return __assign_and_notify(obj, obj.*(prop.get_value()), *typed_value, prop.name);
+			}
+			assert(false);// 无法赋值 类型不匹配!!
+			return std::any();
+		}
+
+		// 成员函数指针的参数个数
+		template <typename F>
+		struct __member_func_arity;
+		template <typename R, typename C, typename... A>
+		struct __member_func_arity<R(C::*)(A...)> : std::integral_constant<size_t, sizeof...(A)> {};
+		template <typename R, typename C, typename... A>
+		struct __member_func_arity<R(C::*)(A...) const> : std::integral_constant<size_t, sizeof...(A)> {};
+		template <typename R, typename C, typename... A>
+		struct __member_func_arity<R(C::*)(A...) noexcept> : std::integral_constant<size_t, sizeof...(A)> {};
+		template <typename R, typename C, typename... A>
+		struct __member_func_arity<R(C::*)(A...) const noexcept> : std::integral_constant<size_t, sizeof...(A)> {};
+
+		template <typename T, typename Func, size_t... I>
+		std::any __invoke_with_any_args(T& obj, Func func, std::any* args, std::index_sequence<I...>) {
+			if constexpr (std::is_invocable_v<Func, T&, decltype((args[I]))...>) {
+				if constexpr (std::is_void_v<std::invoke_result_t<Func, T&, decltype((args[I]))...>>) {
+					std::invoke(func, obj, args[I]...);
+					return std::any();
+				}
+				else {
+					return std::invoke(func, obj, args[I]...);
+				}
+			}
+			else {
+				assert(false);// 参数不是std::any，不支持动态调用
+				return std::any();
+			}
+		}
+
+		template <typename T, size_t I>
+		std::any __invoke_member_func_any_thunk(T& obj, std::any* args, size_t arg_count) {
+			constexpr auto func = std::get<I>(std::remove_cv_t<T>::member_funcs());
+			constexpr size_t arity = __member_func_arity<decltype(func.get_func())>::value;
+			if (arg_count != arity) {
+				assert(false);// 调用参数个数不匹配
+				return std::any();
+			}
+			return __invoke_with_any_args(obj, func.get_func(), args, std::make_index_sequence<arity>());
+		}
+
+		// 元信息里的类型擦除函数：把IReflectable转回具体类型，再调用按下标生成的thunk
+		template <typename T, size_t I>
+		std::any __meta_get_field_thunk(const IReflectable& obj) {
+			return __get_field_value_thunk<const T, I>(static_cast<const T&>(obj));
+		}
+		template <typename T, size_t I>
+		std::any __meta_assign_field_thunk(IReflectable& obj, const std::any& value) {
+			return __assign_field_any_thunk<T, I>(static_cast<T&>(obj), value);
+		}
+		template <typename T, size_t I>
+		std::any __meta_invoke_member_func_thunk(IReflectable& obj, std::any* args, size_t arg_count) {
+			return __invoke_member_func_any_thunk<T, I>(static_cast<T&>(obj), args, arg_count);
+		}
+
+		template <typename T, typename FuncPtr, typename FuncTuple, size_t N = 0>
+		constexpr const char* __get_member_func_name_impl(FuncPtr func_ptr, const FuncTuple& tp) {
+			if constexpr (N >= std::tuple_size_v<FuncTuple>) {
+				return nullptr; // Not Found!
+			}
+			else {
+				const auto& func = std::get<N>(tp);
+				if constexpr (std::is_same< decltype(func.get_func()), FuncPtr >::value) {
+					return func.name;
+				}
+				else {
+					return __get_member_func_name_impl<T, FuncPtr, FuncTuple, N + 1>(func_ptr, tp);
+				}
+			}
+		}
+	}
+
+	template <typename T, size_t N = 0>
+	std::any get_field_value(T* obj, const char* name) {
+		return obj ? internal::__get_field_value_impl(*obj, name) : std::any();
+	}
+	template <typename T, typename Value>
+	std::any assign_field_value(T* obj, const char* name, const Value& value) {
+		return obj ? internal::__assign_field_value_impl(*obj, name, value) : std::any();
+	}
+
+	template <typename T, typename... Args>
+	constexpr std::any invoke_member_func(T* obj, const char* name, Args&&... args) {
+		return obj ? internal::__invoke_member_func_impl(*obj, name, std::forward<Args>(args)...) : std::any();
+	}
+
+	template <typename T, typename... Args>
+	constexpr std::any invoke_member_func_safe(T* obj, const char* name, Args&&... args) {
+		return obj ? internal::__invoke_member_func_impl<true>(*obj, name, std::forward<Args>(args)...) : std::any();
+	}
+
+
+	// 返回字段的指针，字段不存在或者类型不是FieldType时返回nullptr。不拷贝字段，也不分配内存
+	template <typename FieldType, typename T>
+	auto get_field_ref(T* obj, const char* name) {
+		using Result = std::conditional_t<std::is_const_v<T>, const FieldType*, FieldType*>;
+		return obj ? static_cast<Result>(internal::__get_field_ref_impl<std::remove_cv_t<FieldType>>(*obj, name)) : nullptr;
+	}
+
+	// 把字段的左值交给func(通常是泛型lambda，需要能接受所有字段类型)，找不到字段时返回false
+	template <typename T, typename Func>
+	bool visit_field(T* obj, const char* name, Func&& func) {
+		return obj ? internal::__visit_field_impl(*obj, name, func) : false;
+	}
+
+	template <typename T, typename FuncPtr>
+	constexpr const char* get_member_func_name(FuncPtr func_ptr) {
+		constexpr auto funcs = T::member_funcs();
+		return internal::__get_member_func_name_impl<T, FuncPtr>(func_ptr, funcs);
+	}
+
+
+	// 这个类型特征模板用于遍历获取反射信息
+	template <typename T>
+	struct For {
+		static_assert(std::is_class_v<T>, "Reflector requires a class type.");
+
+		// 遍历所有字段名称
+		template <typename Func>
+		static void for_each_propertie_name(Func&& func) {
+			constexpr auto props = T::properties_();
+			std::apply([&](auto... x) {
+				((func(x.name)), ...);
+				}, props);
+		}
+
+		// 遍历所有字段值
+		template <typename Func>
+		static void for_each_propertie_value(T* obj, Func&& func) {
+			constexpr auto props = T::properties_();
+			std::apply([&](auto... x) {
+				((func(x.name, obj->*(x.get_value()))), ...);
+				}, props);
+		}
+
+		// 遍历所有函数名称
+		template <typename Func>
+		static void for_each_member_func_name(Func&& func) {
+			constexpr auto props = T::member_funcs();
+			std::apply([&](auto... x) {
+				((func(x.name)), ...);
+				}, props);
+		}
+	};
+
+	// 二进制序列化：按REFLECTABLE_PROPERTIES的字段顺序编码，多字节数值统一按小端存放。
+	// 定长字段(算术类型和枚举)集中放在每个对象编码的开头，一次预留空间后按编译期算好的偏移拷贝；
+	// 之后是变长字段：std::string和std::vector先写长度(变长整数)再写内容，嵌套的可反射类型递归编码。
+
+	// 追加写入的缓冲区。可以连续写入多个对象，也可以每写完一部分就取走data()/size()再clear()
+	class BinaryWriter {
+	public:
+		// 在末尾预留n字节并返回写入位置，下一次写入之后指针失效
+		char* append(size_t n) {
+			if (capacity_ - size_ < n) {
+				grow(n);
+			}
+			char* p = data_.get() + size_;
+			size_ += n;
+			return p;
+		}
+		void write_bytes(const void* data, size_t n) {
+			if (n) {
+				std::memcpy(append(n), data, n);
+			}
+		}
+		template <typename T>
+		void write(const T& value);
+		// 无符号LEB128，小于128的值只占一个字节
+		void write_varint(uint64_t value) {
+			if (capacity_ - size_ < 10) {
+				grow(10);
+			}
+			char* p = data_.get() + size_;
+			while (value >= 0x80) {
+				*p++ = static_cast<char>(value | 0x80);
+				value >>= 7;
+			}
+			*p++ = static_cast<char>(value);
+			size_ = p - data_.get();
+		}
+		void write_string(std::string_view text) {
+			write_varint(text.size());
+			write_bytes(text.data(), text.size());
+		}
+
+		const char* data() const { return data_.get(); }
+		size_t size() const { return size_; }
+		std::string_view view() const { return std::string_view(data_.get(), size_); }
+		void clear() { size_ = 0; }
+
+	private:
+		void grow(size_t n) {
+			const size_t capacity = std::max<size_t>({ capacity_ * 2, size_ + n, 256 });
+			std::unique_ptr<char[]> data(new char[capacity]);
+			if (size_) {
+				std::memcpy(data.get(), data_.get(), size_);
+			}
+			data_ = std::move(data);
+			capacity_ = capacity;
+		}
+
+		std::unique_ptr<char[]> data_;
+		size_t size_ = 0;
+		size_t capacity_ = 0;
+	};
+
+	// 从一段内存中顺序读取，不拷贝数据。数据不完整时抛出std::runtime_error
+	class BinaryReader {
+	public:
+		BinaryReader(const void* data, size_t size) : cursor_(static_cast<const char*>(data)), end_(cursor_ + size) {}
+		explicit BinaryReader(std::string_view data) : BinaryReader(data.data(), data.size()) {}
+
+		const char* consume(size_t n) {
+			if (static_cast<size_t>(end_ - cursor_) < n) {
+				throw std::runtime_error("binary data is truncated!");
+			}
+			return std::exchange(cursor_, cursor_ + n);
+		}
+		template <typename T>
+		T read();
+		uint64_t read_varint() {
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				const uint8_t byte = static_cast<uint8_t>(*consume(1));
+				if (shift == 63 && byte > 1) {// 第10个字节只剩最高1位，更大的值说明数据损坏
+					break;
+				}
+				value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+				if (!(byte & 0x80)) {
+					return value;
+				}
+			}
+			throw std::runtime_error("binary data has a bad varint!");
+		}
+		// 元素个数，至少还要剩下count*min_element_size字节，避免损坏的数据导致巨大的内存分配
+		size_t read_count(size_t min_element_size = 1) {
+			const uint64_t count = read_varint();
+			if (min_element_size && count > remaining() / min_element_size) {
+				throw std::runtime_error("binary data is truncated!");
+			}
+			return static_cast<size_t>(count);
+		}
+		// 返回的string_view指向原始数据
+		std::string_view read_string() {
+			const size_t n = read_count();
+			return std::string_view(consume(n), n);
+		}
+
+		size_t remaining() const { return end_ - cursor_; }
+		bool at_end() const { return cursor_ == end_; }
+
+	private:
+		const char* cursor_;
+		const char* end_;
+	};
+
+	namespace internal {
+		inline constexpr bool __little_endian =
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			false;
+#else
+			true;
+#endif
+
+		// bool固定占一个字节
+		template <typename T>
+		constexpr size_t __binary_size_v = std::is_same_v<T, bool> ? 1 : sizeof(T);
+
+		template <typename T>
+		void __store_le(char* dst, const T& value) {
+			if constexpr (std::is_same_v<T, bool>) {
+				*dst = value ? 1 : 0;
+			}
+			else {
+				std::memcpy(dst, &value, sizeof(T));
+				if constexpr (!__little_endian) {
+					std::reverse(dst, dst + sizeof(T));
+				}
+			}
+		}
+		template <typename T>
+		T __load_le(const char* src) {
+			if constexpr (std::is_same_v<T, bool>) {
+				return *src != 0;
+			}
+			else {
+				T value;
+				if constexpr (__little_endian) {
+					std::memcpy(&value, src, sizeof(T));
+				}
+				else {
+					char bytes[sizeof(T)];
+					std::reverse_copy(src, src + sizeof(T), bytes);
+					std::memcpy(&value, bytes, sizeof(T));
+				}
+				return value;
+			}
+		}
+
+		template <typename T, typename = void>
+		struct __has_properties : std::false_type {};
+		template <typename T>
+		struct __has_properties<T, std::void_t<decltype(T::properties_())>> : std::true_type {};
+
+		template <typename T>
+		struct __is_std_vector : std::false_type {};
+		template <typename E>
+		struct __is_std_vector<std::vector<E>> : std::true_type {};
+
+		template <typename T>
+		constexpr bool __is_fixed_field_v = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+		template <typename T, size_t I>
+		using __field_type_t = std::remove_cv_t<std::remove_reference_t<
+			decltype(std::declval<T&>().*(std::get<I>(T::properties_()).get_value()))>>;
+
+		template <typename T>
+		constexpr size_t __property_count_v = std::tuple_size_v<decltype(T::properties_())>;
+
+		template <typename T>
+		constexpr bool __is_binary_serializable();
+		template <typename T, size_t... I>
+		constexpr bool __are_fields_binary_serializable(std::index_sequence<I...>) {
+			return (__is_binary_serializable<__field_type_t<T, I>>() && ...);
+		}
+		// 支持算术类型、枚举、std::string、元素可序列化的std::vector，以及字段都可序列化的可反射类型
+		template <typename T>
+		constexpr bool __is_binary_serializable() {
+			if constexpr (__is_fixed_field_v<T> || std::is_same_v<T, std::string>) {
+				return true;
+			}
+			else if constexpr (__is_std_vector<T>::value) {
+				return __is_binary_serializable<typename T::value_type>();
+			}
+			else if constexpr (__has_properties<T>::value) {
+				return __are_fields_binary_serializable<T>(std::make_index_sequence<__property_count_v<T>>());
+			}
+			else {
+				return false;
+			}
+		}
+
+		// 字段名和字段类型的哈希，解码时用来确认两端的字段结构一致
+		constexpr uint32_t __mix_hash(uint32_t hash, uint32_t value) {
+			return (hash ^ value) * 16777619u;
+		}
+		template <typename T>
+		constexpr uint32_t __binary_schema_hash();
+		template <typename T, size_t... I>
+		constexpr uint32_t __fields_schema_hash(std::index_sequence<I...>) {
+			uint32_t hash = 2166136261u;
+			((hash = __mix_hash(__mix_hash(hash, __hash_name(std::get<I>(T::properties_()).name)), __binary_schema_hash<__field_type_t<T, I>>())), ...);
+			return hash;
+		}
+		template <typename T>
+		constexpr uint32_t __binary_schema_hash() {
+			if constexpr (__is_fixed_field_v<T>) {
+				using Value = std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::enable_if<true, T>>;
+				using Type = typename Value::type;
+				return 0x100u | (std::is_floating_point_v<Type> ? 0x200u : 0u) | (std::is_signed_v<Type> ? 0x400u : 0u) |
+					(std::is_same_v<Type, bool> ? 0x2000u : 0u) | static_cast<uint32_t>(__binary_size_v<Type>);
+			}
+			else if constexpr (std::is_same_v<T, std::string>) {
+				return 0x800u;
+			}
+			else if constexpr (__is_std_vector<T>::value) {
+				return __mix_hash(0x1000u, __binary_schema_hash<typename T::value_type>());
+			}
+			else {
+				return __fields_schema_hash<T>(std::make_index_sequence<__property_count_v<T>>());
+			}
+		}
+
+		// 定长字段在对象编码开头的偏移，最后一项是定长部分的总大小
+		template <typename T, size_t... I>
+		constexpr auto __make_fixed_offsets(std::index_sequence<I...>) {
+			constexpr size_t sizes[] = { (__is_fixed_field_v<__field_type_t<T, I>> ? __binary_size_v<__field_type_t<T, I>> : 0)..., 0 };
+			std::array<size_t, sizeof...(I) + 1> offsets{};
+			for (size_t i = 0; i < sizeof...(I); ++i) {
+				offsets[i + 1] = offsets[i] + sizes[i];
+			}
+			return offsets;
+		}
+		template <typename T>
+		struct __BinaryLayout {
+			static constexpr auto offsets = __make_fixed_offsets<T>(std::make_index_sequence<__property_count_v<T>>());
+			static constexpr size_t fixed_size = offsets[__property_count_v<T>];
+		};
+
+		template <typename T>
+		void __encode_value(BinaryWriter& out, const T& value);
+		template <typename T>
+		void __decode_value(BinaryReader& in, T& value);
+
+		template <typename T, size_t... I>
+		void __encode_fields(BinaryWriter& out, const T& obj, std::index_sequence<I...>) {
+			constexpr auto props = T::properties_();
+			if constexpr (__BinaryLayout<T>::fixed_size > 0) {
+				char* block = out.append(__BinaryLayout<T>::fixed_size);
+				([&] {
+					if constexpr (__is_fixed_field_v<__field_type_t<T, I>>) {
+						__store_le(block + __BinaryLayout<T>::offsets[I], obj.*(std::get<I>(props).get_value()));
+					}
+				}(), ...);
+			}
+			([&] {
+				if constexpr (!__is_fixed_field_v<__field_type_t<T, I>>) {
+					__encode_value(out, obj.*(std::get<I>(props).get_value()));
+				}
+			}(), ...);
+		}
+		template <typename T, size_t... I>
+		void __decode_fields(BinaryReader& in, T& obj, std::index_sequence<I...>) {
+			constexpr auto props = T::properties_();
+			if constexpr (__BinaryLayout<T>::fixed_size > 0) {
+				const char* block = in.consume(__BinaryLayout<T>::fixed_size);
+				([&] {
+					if constexpr (__is_fixed_field_v<__field_type_t<T, I>>) {
+						obj.*(std::get<I>(props).get_value()) = __load_le<__field_type_t<T, I>>(block + __BinaryLayout<T>::offsets[I]);
+					}
+				}(), ...);
+			}
+			([&] {
+				if constexpr (!__is_fixed_field_v<__field_type_t<T, I>>) {
+					__decode_value(in, obj.*(std::get<I>(props).get_value()));
+				}
+			}(), ...);
+		}
+
+		template <typename T>
+		void __encode_value(BinaryWriter& out, const T& value) {
+			if constexpr (__is_fixed_field_v<T>) {
+				__store_le(out.append(__binary_size_v<T>), value);
+			}
+			else if constexpr (std::is_same_v<T, std::string>) {
+				out.write_string(value);
+			}
+			else if constexpr (__is_std_vector<T>::value) {
+				using Element = typename T::value_type;
+				out.write_varint(value.size());
+				if constexpr (__is_fixed_field_v<Element> && !std::is_same_v<Element, bool> && __little_endian) {
+					out.write_bytes(value.data(), value.size() * sizeof(Element));// 小端平台上数值数组整块拷贝
+				}
+				else {
+					for (const auto& element : value) {
+						__encode_value<Element>(out, element);
+					}
+				}
+			}
+			else {
+				__encode_fields(out, value, std::make_index_sequence<__property_count_v<T>>());
+			}
+		}
+		template <typename T>
+		void __decode_value(BinaryReader& in, T& value) {
+			if constexpr (__is_fixed_field_v<T>) {
+				value = __load_le<T>(in.consume(__binary_size_v<T>));
+			}
+			else if constexpr (std::is_same_v<T, std::string>) {
+				value = in.read_string();
+			}
+			else if constexpr (__is_std_vector<T>::value) {
+				using Element = typename T::value_type;
+				if constexpr (__is_fixed_field_v<Element> && !std::is_same_v<Element, bool> && __little_endian) {
+					const size_t count = in.read_count(sizeof(Element));
+					value.resize(count);
+					if (count) {
+						std::memcpy(value.data(), in.consume(count * sizeof(Element)), count * sizeof(Element));
+					}
+				}
+				else {
+					const size_t count = in.read_count(std::is_same_v<Element, bool> ? 1 : 0);
+					value.resize(count);
+					for (size_t i = 0; i < count; ++i) {
+						if constexpr (std::is_same_v<Element, bool>) {
+							value[i] = __load_le<bool>(in.consume(1));
+						}
+						else {
+							__decode_value(in, value[i]);
+						}
+					}
+				}
+			}
+			else {
+				__decode_fields(in, value, std::make_index_sequence<__property_count_v<T>>());
+			}
+		}
+	}
+
+	template <typename T>
+	void BinaryWriter::write(const T& value) {
+		internal::__encode_value(*this, value);
+	}
+	template <typename T>
+	T BinaryReader::read() {
+		T value{};
+		internal::__decode_value(*this, value);
+		return value;
+	}
+
+	// 把obj的反射字段追加到out
+	template <typename T>
+	void encode_binary(BinaryWriter& out, const T& obj) {
+		static_assert(internal::__is_binary_serializable<T>(), "field type is not binary serializable");
+		internal::__encode_fields(out, obj, std::make_index_sequence<internal::__property_count_v<T>>());
+	}
+	// 从in读出encode_binary写入的字段，直接赋值给obj的字段，不发出属性变化通知
+	template <typename T>
+	void decode_binary(BinaryReader& in, T& obj) {
+		static_assert(internal::__is_binary_serializable<T>(), "field type is not binary serializable");
+		internal::__decode_fields(in, obj, std::make_index_sequence<internal::__property_count_v<T>>());
+	}
+
+	// 上面都是静态反射功能，以下是动态反射机制的支持代码：
+
+	// 名字到下标的哈希表，指向__NameTable在编译期生成的数据，和具体类型无关，查找可以内联
+	struct NameIndex {
+		const char* const* names;
+		const uint32_t* hashes;
+		const uint32_t* slots;
+		size_t mask;
+
+		// 找不到返回invalid_index
+		size_t find(const char* name) const {
+			if (!name) {
+				return invalid_index;
+			}
+			const uint32_t hash = internal::__hash_name(name);
+			for (size_t pos = hash & mask; slots[pos] != 0; pos = (pos + 1) & mask) {
+				const size_t index = slots[pos] - 1;
+				if (hashes[index] == hash && internal::__name_equal(names[index], name)) {
+					return index;
+				}
+			}
+			return invalid_index;
+		}
+	};
+
+	// 动态反射的元信息：每个类型一份，由DECL_DYNAMIC_REFLECTABLE在编译期生成。
+	// 属性和成员函数按声明顺序存成平坦数组，每一项带一个类型擦除的函数指针，动态调用按下标直接取用
+	struct PropertyInfo {
+		const char* name;
+		std::any(*get)(const IReflectable& obj);
+		std::any(*set)(IReflectable& obj, const std::any& value);// 要求类型完全一致
+		// 定长字段(算术类型和枚举)在encode_binary编码开头的偏移和大小，load直接从编码里读出字段值，
+		// 快照不创建对象就能读取字段。其他字段或者类型不支持二进制序列化时load为nullptr
+		uint32_t binary_offset;
+		uint32_t binary_size;
+		std::any(*load)(const char* data);
+	};
+
+	struct MethodInfo {
+		const char* name;
+		size_t arity;
+		std::any(*invoke)(IReflectable& obj, std::any* args, size_t arg_count);// 参数个数必须等于arity
+	};
+
+	struct TypeInfo {
+		std::string_view name;
+		const PropertyInfo* properties;
+		size_t property_count;
+		const MethodInfo* methods;
+		size_t method_count;
+		NameIndex property_index;
+		NameIndex method_index;
+		std::shared_ptr<IReflectable>(*create)(std::pmr::memory_resource* resource);// nullptr时使用make_shared
+		// 二进制序列化，见encode_binary/decode_binary。字段类型不支持时为nullptr
+		void(*encode)(const IReflectable& obj, BinaryWriter& out);
+		void(*decode)(IReflectable& obj, BinaryReader& in);
+		uint32_t schema_hash;// 字段名和字段类型的哈希，解码前用来确认字段结构没有变化
+	};
+
+	namespace internal {
+		template <size_t N>
+		constexpr NameIndex __make_name_index(const __NameTable<N>& table) {
+			return NameIndex{ table.names.data(), table.hashes.data(), table.slots.data(), table.capacity - 1 };
+		}
+
+		template <typename T, size_t I>
+		std::any __meta_load_field_thunk(const char* data) {
+			return __load_le<__field_type_t<T, I>>(data);
+		}
+		template <typename T, size_t I>
+		constexpr PropertyInfo __make_property_info() {
+			PropertyInfo info{ std::get<I>(T::properties_()).name, &__meta_get_field_thunk<T, I>, &__meta_assign_field_thunk<T, I>, 0, 0, nullptr };
+			if constexpr (__is_fixed_field_v<__field_type_t<T, I>>) {
+				if constexpr (__is_binary_serializable<T>()) {
+					info.binary_offset = static_cast<uint32_t>(__BinaryLayout<T>::offsets[I]);
+					info.binary_size = static_cast<uint32_t>(__binary_size_v<__field_type_t<T, I>>);
+					info.load = &__meta_load_field_thunk<T, I>;
+				}
+			}
+			return info;
+		}
+		template <typename T, size_t... I>
+		constexpr auto __make_property_infos(std::index_sequence<I...>) {
+			return std::array<PropertyInfo, sizeof...(I)>{ __make_property_info<T, I>()... };
+		}
+		template <typename T, size_t... I>
+		constexpr auto __make_method_infos(std::index_sequence<I...>) {
+			return std::array<MethodInfo, sizeof...(I)>{ MethodInfo{ std::get<I>(T::member_funcs()).name,
+				__member_func_arity<decltype(std::get<I>(T::member_funcs()).get_func())>::value,
+				&__meta_invoke_member_func_thunk<T, I> }... };
+		}
+
+		template <typename T>
+		void __meta_encode_thunk(const IReflectable& obj, BinaryWriter& out) {
+			encode_binary(out, static_cast<const T&>(obj));
+		}
+		template <typename T>
+		void __meta_decode_thunk(IReflectable& obj, BinaryReader& in) {
+			decode_binary(in, static_cast<T&>(obj));
+		}
+		template <typename T>
+		constexpr auto __make_meta_encoder() {
+			using Encoder = void(*)(const IReflectable&, BinaryWriter&);
+			if constexpr (__is_binary_serializable<T>()) {
+				return Encoder(&__meta_encode_thunk<T>);
+			}
+			else {
+				return Encoder(nullptr);
+			}
+		}
+		template <typename T>
+		constexpr auto __make_meta_decoder() {
+			using Decoder = void(*)(IReflectable&, BinaryReader&);
+			if constexpr (__is_binary_serializable<T>()) {
+				return Decoder(&__meta_decode_thunk<T>);
+			}
+			else {
+				return Decoder(nullptr);
+			}
+		}
+
+		template <typename T>
+		constexpr uint32_t __make_meta_schema_hash() {
+			if constexpr (__is_binary_serializable<T>()) {
+				return __binary_schema_hash<T>();
+			}
+			else {
+				return 0;
+			}
+		}
+
+		// 类型T的元信息，inline静态成员保证整个程序只有一份，地址可以用来判断类型是否相同
+		template <typename T>
+		struct __TypeInfoHolder {
+			static constexpr auto properties = __make_property_infos<T>(
+				std::make_index_sequence<std::tuple_size_v<decltype(T::properties_())>>());
+			static constexpr auto methods = __make_method_infos<T>(
+				std::make_index_sequence<std::tuple_size_v<decltype(T::member_funcs())>>());
+			static constexpr TypeInfo value{ T::static_type_name(), properties.data(), properties.size(),
+				methods.data(), methods.size(), __make_name_index(__PropertyTable<T>::value), __make_name_index(__MemberFuncTable<T>::value),
+				&T::create_instance, __make_meta_encoder<T>(), __make_meta_decoder<T>(),
+				__make_meta_schema_hash<T>() };
+		};
+
+	}
+
+	// IReflectable提供动态反射功能的支持。
+	// 只有meta()一个虚函数，其余接口都是通过元信息的平坦数组分发的普通函数，调用的参数个数也不再受虚表限制
+	class IReflectable : public std::enable_shared_from_this<IReflectable> {
+	public:
+		virtual ~IReflectable() = default;
+		virtual const TypeInfo& meta() const = 0;
+
+		std::string_view get_type_name() const { return meta().name; }
+
+		std::any get_field_value_by_name(const char* name) const {
+			const TypeInfo& info = meta();
+			const size_t index = info.property_index.find(name);
+			return index < info.property_count ? info.properties[index].get(*this) : std::any();
+		}
+
+		template <typename... Params>
+		std::any invoke_member_func_by_name(const char* name, Params&&... params) {
+			const TypeInfo& info = meta();
+			const size_t index = info.method_index.find(name);
+			if (index >= info.method_count) {
+				assert(false);// 没找到！
+				return std::any();
+			}
+			std::array<std::any, sizeof...(Params)> args{ std::any(std::forward<Params>(params))... };
+			return info.methods[index].invoke(*this, args.data(), args.size());
+		}
+
+		// 按下标访问，下标通过find_xxx_index解析一次后可以反复使用，见PropertyHandle/MethodHandle
+		size_t find_property_index(const char* name) const { return meta().property_index.find(name); }
+		std::any get_field_value_by_index(size_t index) const {
+			const TypeInfo& info = meta();
+			return index < info.property_count ? info.properties[index].get(*this) : std::any();
+		}
+		std::any assign_field_value_by_index(size_t index, const std::any& value) {
+			const TypeInfo& info = meta();
+			return index < info.property_count ? info.properties[index].set(*this, value) : std::any();
+		}
+		size_t find_member_func_index(const char* name) const { return meta().method_index.find(name); }
+		std::any invoke_member_func_by_index(size_t index, std::any* args, size_t arg_count) {
+			const TypeInfo& info = meta();
+			return index < info.method_count ? info.methods[index].invoke(*this, args, arg_count) : std::any();
+		}
+	};
+
+	// 对象池：用make创建的对象(连同shared_ptr的控制块)和QObject内部的容器都从这里分配，整棵对象树只占用少量大块内存。
+	// 每个对象都持有对象池的引用，最后一个对象释放后对象池连同所有大块内存一起释放；对象池存活期间释放的内存按16字节分档在池内复用。
+	// 分配和释放用互斥锁保护，对象可以在任意线程释放。
+	class QObjectArena final : public std::pmr::memory_resource, public std::enable_shared_from_this<QObjectArena> {
+	public:
+		// 分配给shared_ptr控制块和对象的分配器，持有对象池的引用
+		template <typename T>
+		class Allocator {
+		public:
+			using value_type = T;
+
+			explicit Allocator(std::shared_ptr<QObjectArena> arena) : arena_(std::move(arena)) {}
+			template <typename U>
+			Allocator(const Allocator<U>& other) : arena_(other.arena_) {}
+
+			T* allocate(size_t n) {
+				return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+			}
+			void deallocate(T* p, size_t n) {
+				arena_->deallocate(p, n * sizeof(T), alignof(T));
+			}
+
+			template <typename U>
+			bool operator==(const Allocator<U>& other) const { return arena_ == other.arena_; }
+			template <typename U>
+			bool operator!=(const Allocator<U>& other) const { return arena_ != other.arena_; }
+
+		private:
+			template <typename U>
+			friend class Allocator;
+			std::shared_ptr<QObjectArena> arena_;
+		};
+
+		static constexpr size_t kSlabSize = 256 * 1024;
+		static constexpr size_t kGranularity = 16;
+		static constexpr size_t kMaxPooledSize = 4096;// 更大的内存(比如很长的子对象数组)直接向系统申请
+		static constexpr size_t kMaxCachedSlabs = 64;// 进程内最多缓存的空闲大块内存数量
+
+		static std::shared_ptr<QObjectArena> create() {
+			return std::shared_ptr<QObjectArena>(new QObjectArena());
+		}
+
+		template <typename T, typename... Args>
+		std::shared_ptr<T> make(Args&&... args) {
+			CurrentScope scope(this);
+			return std::allocate_shared<T>(Allocator<T>(shared_from_this()), std::forward<Args>(args)...);
+		}
+
+		// 在任意memory_resource上创建对象：对象池等同于make；其他memory_resource通过polymorphic_allocator分配，
+		// QObject内部的容器也从它分配，调用方需要保证它比对象活得久；resource为nullptr时使用make_shared
+		template <typename T, typename... Args>
+		static std::shared_ptr<T> make_in(std::pmr::memory_resource* resource, Args&&... args) {
+			if (!resource) {
+				return std::make_shared<T>(std::forward<Args>(args)...);
+			}
+			if (typeid(*resource) == typeid(QObjectArena)) {
+				return static_cast<QObjectArena*>(resource)->make<T>(std::forward<Args>(args)...);
+			}
+			CurrentScope scope(resource);
+			return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(resource), std::forward<Args>(args)...);
+		}
+
+		// QObject构造时取出正在用make/make_in创建的memory_resource，只有最外层的对象使用，构造函数里再创建的其他对象不受影响
+		static std::pmr::memory_resource* take_current_resource() {
+			std::pmr::memory_resource* resource = std::exchange(s_currentResource, nullptr);
+			return resource ? resource : std::pmr::new_delete_resource();
+		}
+
+		~QObjectArena() {
+			SlabCache& cache = slab_cache();
+			std::lock_guard<std::mutex> lock(cache.mutex);
+			for (void* slab : slabs_) {
+				if (cache.slabs.size() < kMaxCachedSlabs) {
+					cache.slabs.push_back(slab);
+				}
+				else {
+					::operator delete(slab);
+				}
+			}
+		}
+
+	private:
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		// 对象池释放的大块内存先缓存起来，反复创建和销毁对象树时直接复用，不用重新向系统申请和缺页
+		struct SlabCache {
+			std::mutex mutex;
+			std::vector<void*> slabs;
+			~SlabCache() {
+				for (void* slab : slabs) {
+					::operator delete(slab);
+				}
+			}
+		};
+		static SlabCache& slab_cache() {
+			static SlabCache cache;
+			return cache;
+		}
+
+		void* new_slab() {
+			{
+				SlabCache& cache = slab_cache();
+				std::lock_guard<std::mutex> lock(cache.mutex);
+				if (!cache.slabs.empty()) {
+					void* slab = cache.slabs.back();
+					cache.slabs.pop_back();
+					return slab;
+				}
+			}
+			return ::operator new(kSlabSize);
+		}
+
+		QObjectArena() = default;
+
+		struct CurrentScope {
+			std::pmr::memory_resource* previous;
+			explicit CurrentScope(std::pmr::memory_resource* resource) : previous(std::exchange(s_currentResource, resource)) {}
+			~CurrentScope() { s_currentResource = previous; }
+		};
+
+		static bool pooled(size_t bytes, size_t alignment) {
+			return bytes <= kMaxPooledSize && alignment <= kGranularity;
+		}
+
+		void* do_allocate(size_t bytes, size_t alignment) override {
+			if (!pooled(bytes, alignment)) {
+				return ::operator new(bytes, std::align_val_t(alignment));
+			}
+			const size_t size = (std::max<size_t>(bytes, 1) + kGranularity - 1) & ~(kGranularity - 1);
+			std::lock_guard<std::mutex> lock(mutex_);
+			FreeBlock*& head = free_[size / kGranularity - 1];
+			if (head) {
+				return std::exchange(head, head->next);
+			}
+			if (static_cast<size_t>(end_ - cursor_) < size) {
+				cursor_ = static_cast<char*>(slabs_.emplace_back(new_slab()));
+				end_ = cursor_ + kSlabSize;
+			}
+			return std::exchange(cursor_, cursor_ + size);
+		}
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+			if (!pooled(bytes, alignment)) {
+				::operator delete(p, std::align_val_t(alignment));
+				return;
+			}
+			const size_t size = (std::max<size_t>(bytes, 1) + kGranularity - 1) & ~(kGranularity - 1);
+			std::lock_guard<std::mutex> lock(mutex_);
+			FreeBlock*& head = free_[size / kGranularity - 1];
+			head = new (p) FreeBlock{ head };
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+
+		std::mutex mutex_;
+		std::vector<void*> slabs_;// 对象池析构时一起释放
+		char* cursor_ = nullptr;// 当前大块内存中未分配部分
+		char* end_ = nullptr;
+		FreeBlock* free_[kMaxPooledSize / kGranularity] = {};
+		static thread_local std::pmr::memory_resource* s_currentResource;
+	};
+
+	using AtomId = uint32_t;
+	using TypeId = uint32_t;
+
+	namespace internal {
+		// 全局的名字驻留表，把信号名、属性名等字符串映射为整数id，id在进程内稳定。
+		// 查找不加锁：开放寻址的索引表通过原子指针发布，插入在互斥锁内进行，扩容时旧索引表保留到进程退出。
+		class AtomTable {
+		public:
+			static constexpr AtomId invalid_atom = static_cast<AtomId>(-1);
+
+			static AtomTable& instance() {
+				static AtomTable table;
+				return table;
+			}
+
+			AtomId intern(std::string_view name) {
+				const size_t hash = std::hash<std::string_view>()(name);
+				if (AtomId id = find(name, hash); id != invalid_atom) {
+					return id;
+				}
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (AtomId id = find(name, hash); id != invalid_atom) {
+					return id;
+				}
+				const Atom& atom = atoms_.emplace_back(Atom{ std::string(name), hash, static_cast<AtomId>(atoms_.size()) });
+				const Index* index = index_.load(std::memory_order_relaxed);
+				if (atoms_.size() * 2 > index->mask + 1) {
+					index = grow(index);// 新索引表已经包含了刚插入的名字
+				}
+				else {
+					insert(*index, &atom);
+				}
+				return atom.id;
+			}
+
+			// 只查找不插入，找不到返回invalid_atom
+			AtomId find(std::string_view name) const {
+				return find(name, std::hash<std::string_view>()(name));
+			}
+
+			std::string_view name(AtomId id) const {
+				std::lock_guard<std::mutex> lock(mutex_);
+				return id < atoms_.size() ? std::string_view(atoms_[id].name) : std::string_view();
+			}
+
+		private:
+			struct Atom {
+				std::string name;
+				size_t hash;
+				AtomId id;
+			};
+			struct Index {
+				size_t mask;
+				std::unique_ptr<std::atomic<const Atom*>[]> slots;
+				explicit Index(size_t capacity) : mask(capacity - 1), slots(new std::atomic<const Atom*>[capacity]) {
+					for (size_t i = 0; i < capacity; ++i) {
+						slots[i].store(nullptr, std::memory_order_relaxed);
+					}
+				}
+			};
+
+			AtomTable() {
+				index_.store(indexes_.emplace_back(std::make_unique<Index>(256)).get(), std::memory_order_release);
+			}
+
+			AtomId find(std::string_view name, size_t hash) const {
+				const Index* index = index_.load(std::memory_order_acquire);
+				for (size_t i = hash & index->mask;; i = (i + 1) & index->mask) {
+					const Atom* atom = index->slots[i].load(std::memory_order_acquire);
+					if (!atom) {
+						return invalid_atom;
+					}
+					if (atom->hash == hash && atom->name == name) {
+						return atom->id;
+					}
+				}
+			}
+
+			static void insert(const Index& index, const Atom* atom) {
+				size_t i = atom->hash & index.mask;
+				while (index.slots[i].load(std::memory_order_relaxed)) {
+					i = (i + 1) & index.mask;
+				}
+				index.slots[i].store(atom, std::memory_order_release);
+			}
+
+			const Index* grow(const Index* old) {
+				auto& index = indexes_.emplace_back(std::make_unique<Index>((old->mask + 1) * 2));
+				for (const Atom& atom : atoms_) {
+					insert(*index, &atom);
+				}
+				index_.store(index.get(), std::memory_order_release);
+				return index.get();
+			}
+
+			mutable std::mutex mutex_;// 只串行插入
+			std::deque<Atom> atoms_;// deque保证已有元素地址不变
+			std::vector<std::unique_ptr<Index>> indexes_;// 正在查找的线程可能还在读旧索引表，都保留
+			std::atomic<const Index*> index_{ nullptr };
+		};
+
+		// 类型注册工具：类型名用resolve解析成TypeId一次，之后按TypeId创建对象，不再查找字符串。
+		// 注册在互斥锁内进行，每次注册生成一份新的只读快照并通过原子指针发布，resolve和create不加锁；旧快照保留到进程退出
+		class TypeRegistry {
+		public:
+			using CreatorFunc = std::function<std::shared_ptr<IReflectable>(std::pmr::memory_resource*)>;
+			static constexpr TypeId invalid_type = static_cast<TypeId>(-1);
+
+			static TypeRegistry& instance() {
+				static TypeRegistry registry;
+				return registry;
+			}
+
+			// DECL_DYNAMIC_REFLECTABLE的类型按元信息注册，创建时直接调用元信息里的函数指针
+			TypeId register_type(const TypeInfo& info) {
+				return add(Entry{ std::string(info.name), info.create, nullptr, &info });
+			}
+			// 自定义的工厂函数。同名类型重复注册时替换原来的工厂，TypeId不变
+			TypeId register_type(const std::string_view type_name, CreatorFunc creator) {
+				return add(Entry{ std::string(type_name), nullptr, std::move(creator), nullptr });
+			}
+
+			// 找不到返回invalid_type
+			TypeId resolve(const std::string_view type_name) const {
+				const Snapshot* snapshot = snapshot_.load(std::memory_order_acquire);
+				auto it = snapshot->ids.find(type_name);
+				return it != snapshot->ids.end() ? it->second : invalid_type;
+			}
+			// 自定义工厂注册的类型没有元信息，返回nullptr
+			const TypeInfo* type_info(TypeId id) const {
+				const Entry* entry = find(id);
+				return entry ? entry->info : nullptr;
+			}
+
+			// 指定resource时对象从它分配，传入对象池时等同于QObjectArena::make
+			std::shared_ptr<IReflectable> create(TypeId id, std::pmr::memory_resource* resource = nullptr) const {
+				const Entry* entry = find(id);
+				return entry ? entry->create_one(resource) : nullptr;
+			}
+			std::shared_ptr<IReflectable> create(const std::string_view type_name, std::pmr::memory_resource* resource = nullptr) const {
+				return create(resolve(type_name), resource);
+			}
+
+			// 批量创建count个对象追加到out，只查找一次工厂，返回实际创建的个数(类型不存在时为0)
+			size_t create_n(TypeId id, size_t count, std::vector<std::shared_ptr<IReflectable>>& out,
+				std::pmr::memory_resource* resource = nullptr) const {
+				const Entry* entry = find(id);
+				if (!entry) {
+					return 0;
+				}
+				out.reserve(out.size() + count);
+				for (size_t i = 0; i < count; ++i) {
+					out.push_back(entry->create_one(resource));
+				}
+				return count;
+			}
+			std::vector<std::shared_ptr<IReflectable>> create_n(TypeId id, size_t count, std::pmr::memory_resource* resource = nullptr) const {
+				std::vector<std::shared_ptr<IReflectable>> objects;
+				create_n(id, count, objects, resource);
+				return objects;
+			}
+
+		private:
+			struct Entry {
+				std::string name;
+				std::shared_ptr<IReflectable>(*create)(std::pmr::memory_resource*);
+				CreatorFunc creator;
+				const TypeInfo* info;
+
+				std::shared_ptr<IReflectable> create_one(std::pmr::memory_resource* resource) const {
+					return create ? create(resource) : creator(resource);
+				}
+			};
+			struct Snapshot {
+				std::unordered_map<std::string_view, TypeId> ids;
+				std::vector<const Entry*> entries;// 下标是TypeId
+			};
+
+			TypeRegistry() {
+				snapshot_.store(snapshots_.emplace_back(std::make_unique<Snapshot>()).get(), std::memory_order_release);
+			}
+
+			const Entry* find(TypeId id) const {
+				const Snapshot* snapshot = snapshot_.load(std::memory_order_acquire);
+				return id < snapshot->entries.size() ? snapshot->entries[id] : nullptr;
+			}
+
+			TypeId add(Entry entry) {
+				std::lock_guard<std::mutex> lock(mutex_);
+				const Entry& added = entries_.emplace_back(std::move(entry));
+				auto snapshot = std::make_unique<Snapshot>(*snapshot_.load(std::memory_order_relaxed));
+				auto [it, inserted] = snapshot->ids.try_emplace(added.name, static_cast<TypeId>(snapshot->entries.size()));
+				if (inserted) {
+					snapshot->entries.push_back(&added);
+				}
+				else {
+					snapshot->entries[it->second] = &added;
+				}
+				const TypeId id = it->second;
+				snapshot_.store(snapshots_.emplace_back(std::move(snapshot)).get(), std::memory_order_release);
+				return id;
+			}
+
+			std::mutex mutex_;// 只串行注册
+			std::deque<Entry> entries_;// deque保证已有元素地址不变，快照里的名字和工厂都指向这里
+			std::vector<std::unique_ptr<Snapshot>> snapshots_;// 正在查找的线程可能还在读旧快照，都保留
+			std::atomic<const Snapshot*> snapshot_{ nullptr };
+		};
+
+		// 用于注册类型信息的宏
+#define DECL_DYNAMIC_REFLECTABLE(TypeName) \
+    friend class refl::internal::TypeRegistryEntry<TypeName>; \
+    static constexpr std::string_view static_type_name() { return #TypeName; } \
+    static std::shared_ptr<::refl::IReflectable> create_instance(std::pmr::memory_resource* resource = nullptr) { \
+        return ::refl::QObjectArena::make_in<TypeName>(resource); \
+    } \
+    static const bool is_registered; \
+    const ::refl::TypeInfo& meta() const override { \
+        return ::refl::internal::__TypeInfoHolder<TypeName>::value; \
+    } \
+
+	// 用于在静态区域注册类型的辅助类
+		template <typename T>
+		class TypeRegistryEntry {
+		public:
+			TypeRegistryEntry() {
+				::refl::internal::TypeRegistry::instance().register_type(::refl::internal::__TypeInfoHolder<T>::value);
+			}
+		};
+
+		// 为每个类型定义注册变量，这段宏需要出现在类的cpp中。
+#define REGEDIT_DYNAMIC_REFLECTABLE(TypeName) \
+    const bool TypeName::is_registered = [] { \
+        static ::refl::internal::TypeRegistryEntry<TypeName> entry; \
+        return true; \
+    }();
+
+	}//namespace dynamic
+
+
+	// 预先解析好的属性句柄：按名字解析一次，之后在任意实例上读写都不再比较字符串
+	class PropertyHandle {
+	public:
+		PropertyHandle() = default;
+
+		template <typename T>
+		static PropertyHandle resolve(const char* name) {
+			const TypeInfo& info = internal::__TypeInfoHolder<T>::value;
+			return PropertyHandle(&info, info.property_index.find(name));
+		}
+		static PropertyHandle resolve(const IReflectable* obj, const char* name) {
+			return obj ? PropertyHandle(&obj->meta(), obj->find_property_index(name)) : PropertyHandle();
+		}
+
+		bool valid() const { return index_ != invalid_index; }
+		explicit operator bool() const { return valid(); }
+		size_t index() const { return index_; }
+
+		std::any get(const IReflectable* obj) const {
+			assert(!obj || &obj->meta() == meta_);// 句柄只能用于解析它的类型
+			// 类型已经确定，直接调用元信息里的函数指针，不再经过虚函数
+			return obj && valid() ? meta_->properties[index_].get(*obj) : std::any();
+		}
+		std::any set(IReflectable* obj, const std::any& value) const {
+			assert(!obj || &obj->meta() == meta_);
+			return obj && valid() ? meta_->properties[index_].set(*obj, value) : std::any();
+		}
+
+	private:
+		PropertyHandle(const TypeInfo* meta, size_t index) : meta_(meta), index_(index) {}
+
+		const TypeInfo* meta_ = nullptr;
+		size_t index_ = invalid_index;
+	};
+
+	// 预先解析好的成员函数句柄，参数同invoke_member_func_by_name一样以std::any传递，但不限个数
+	class MethodHandle {
+	public:
+		MethodHandle() = default;
+
+		template <typename T>
+		static MethodHandle resolve(const char* name) {
+			const TypeInfo& info = internal::__TypeInfoHolder<T>::value;
+			return MethodHandle(&info, info.method_index.find(name));
+		}
+		static MethodHandle resolve(const IReflectable* obj, const char* name) {
+			return obj ? MethodHandle(&obj->meta(), obj->find_member_func_index(name)) : MethodHandle();
+		}
+
+		bool valid() const { return index_ != invalid_index; }
+		explicit operator bool() const { return valid(); }
+		size_t index() const { return index_; }
+
+		template <typename... Params>
+		std::any invoke(IReflectable* obj, Params&&... params) const {
+			assert(!obj || &obj->meta() == meta_);// 句柄只能用于解析它的类型
+			if (!obj || !valid()) {
+				return std::any();
+			}
+			std::array<std::any, sizeof...(Params)> args{ std::any(std::forward<Params>(params))... };
+			return meta_->methods[index_].invoke(*obj, args.data(), args.size());
+		}
+
+	private:
+		MethodHandle(const TypeInfo* meta, size_t index) : meta_(meta), index_(index) {}
+
+		const TypeInfo* meta_ = nullptr;
+		size_t index_ = invalid_index;
+	};
+
+	namespace internal {
+		// 带内联存储的小vector，元素个数不超过N时不分配堆内存，用于连接表这类通常很短的列表
+		template <typename T, size_t N>
+		class SmallVector {
+		public:
+			SmallVector() = default;
+			SmallVector(const SmallVector& other) {
+				reserve(other.size_);
+				for (const auto& item : other) {
+					push_back(item);
+				}
+			}
+			SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+				take(std::move(other));
+			}
+			SmallVector& operator=(const SmallVector& other) {
+				if (this != &other) {
+					SmallVector copy(other);
+					clear();
+					take(std::move(copy));
+				}
+				return *this;
+			}
+			SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+				if (this != &other) {
+					clear();
+					take(std::move(other));
+				}
+				return *this;
+			}
+			~SmallVector() {
+				clear();
+			}
+
+			T* begin() { return data_; }
+			T* end() { return data_ + size_; }
+			const T* begin() const { return data_; }
+			const T* end() const { return data_ + size_; }
+			T& operator[](size_t index) { return data_[index]; }
+			const T& operator[](size_t index) const { return data_[index]; }
+			T& back() { return data_[size_ - 1]; }
+			size_t size() const { return size_; }
+			bool empty() const { return size_ == 0; }
+
+			template <typename... Params>
+			T& emplace_back(Params&&... params) {
+				if (size_ == capacity_) {
+					reserve(capacity_ * 2);
+				}
+				new (data_ + size_) T(std::forward<Params>(params)...);
+				return data_[size_++];
+			}
+			void push_back(const T& value) { emplace_back(value); }
+			void push_back(T&& value) { emplace_back(std::move(value)); }
+
+			// 保持顺序删除所有满足条件的元素
+			template <typename Pred>
+			size_t erase_if(Pred&& pred) {
+				size_t kept = 0;
+				for (size_t i = 0; i < size_; ++i) {
+					if (!pred(data_[i])) {
+						if (kept != i) {
+							data_[kept] = std::move(data_[i]);
+						}
+						++kept;
+					}
+				}
+				const size_t removed = size_ - kept;
+				while (size_ > kept) {
+					data_[--size_].~T();
+				}
+				return removed;
+			}
+
+			void clear() {
+				while (size_ > 0) {
+					data_[--size_].~T();
+				}
+				if (data_ != inline_data()) {
+					::operator delete(data_);
+					data_ = inline_data();
+					capacity_ = N;
+				}
+			}
+
+			void reserve(size_t capacity) {
+				if (capacity <= capacity_) {
+					return;
+				}
+				T* new_data = static_cast<T*>(::operator new(capacity * sizeof(T)));
+				for (size_t i = 0; i < size_; ++i) {
+					new (new_data + i) T(std::move(data_[i]));
+					data_[i].~T();
+				}
+				if (data_ != inline_data()) {
+					::operator delete(data_);
+				}
+				data_ = new_data;
+				capacity_ = capacity;
+			}
+
+		private:
+			T* inline_data() { return reinterpret_cast<T*>(inline_storage_); }
+
+			void take(SmallVector&& other) {
+				if (other.data_ != other.inline_data()) {// 堆上的直接接管
+					data_ = other.data_;
+					size_ = other.size_;
+					capacity_ = other.capacity_;
+					other.data_ = other.inline_data();
+					other.size_ = 0;
+					other.capacity_ = N;
+				}
+				else {
+					for (auto& item : other) {
+						emplace_back(std::move(item));
+					}
+					other.clear();
+				}
+			}
+
+			alignas(T) unsigned char inline_storage_[sizeof(T) * N];
+			T* data_ = inline_data();
+			size_t size_ = 0;
+			size_t capacity_ = N;
+		};
+
+		// 当前线程正在进行的快照读取(比如正在emit)。写者在槽函数里发布新快照时，据此扣除自己的读取，并跳过自己还持有的快照
+		struct SnapshotReadRecord {
+			const void* cell;
+			uint64_t epoch;
+			const void* value;
+			SnapshotReadRecord* prev;
+			SnapshotReadRecord* next;
+		};
+		inline thread_local SnapshotReadRecord* t_snapshot_reads = nullptr;
+
+		// 写时复制的快照(RCU风格)：读者只做原子计数，不加锁；写者之间由调用方的互斥锁串行。
+		// 被替换下来的旧快照先挂起，确认没有读者之后再释放。写者从不等待读者，槽函数里connect/disconnect也不会死锁
+		template <typename T>
+		class SnapshotCell {
+		public:
+			class ReadGuard {
+			public:
+				explicit ReadGuard(const SnapshotCell& cell) : cell_(cell) {
+					uint64_t epoch;
+					for (;;) {
+						epoch = cell_.epoch_.load();
+						cell_.readers_[epoch & 1].fetch_add(1);
+						if (cell_.epoch_.load() == epoch) {// 计数期间写者推进了epoch，需要换到新的一边重新计数
+							break;
+						}
+						cell_.readers_[epoch & 1].fetch_sub(1);
+					}
+					record_ = SnapshotReadRecord{ &cell_, epoch, cell_.current_.load(), nullptr, t_snapshot_reads };
+					if (record_.next) {
+						record_.next->prev = &record_;
+					}
+					t_snapshot_reads = &record_;
+				}
+				~ReadGuard() {
+					if (record_.prev) {
+						record_.prev->next = record_.next;
+					}
+					else {
+						t_snapshot_reads = record_.next;
+					}
+					if (record_.next) {
+						record_.next->prev = record_.prev;
+					}
+					cell_.readers_[record_.epoch & 1].fetch_sub(1);
+				}
+				ReadGuard(const ReadGuard&) = delete;
+				ReadGuard& operator=(const ReadGuard&) = delete;
+
+				const T* get() const { return static_cast<const T*>(record_.value); }
+
+			private:
+				const SnapshotCell& cell_;
+				SnapshotReadRecord record_;
+			};
+
+			SnapshotCell() = default;
+			SnapshotCell(const SnapshotCell&) = delete;
+			SnapshotCell& operator=(const SnapshotCell&) = delete;
+			~SnapshotCell() {
+				delete current_.load();
+			}
+
+			ReadGuard read() const {
+				return ReadGuard(*this);
+			}
+
+			// 下面两个接口只能在持有写锁时调用
+			const T* peek() const {
+				return current_.load();
+			}
+			void publish(std::unique_ptr<T> next) {
+				std::unique_ptr<T> old(current_.exchange(next.release()));
+				if (old) {
+					// 记下替换时的epoch：之后开始的读者只能拿到新快照
+					retired_.push_back(Retired{ epoch_.load(), std::move(old) });
+				}
+				reclaim();
+			}
+
+		private:
+			struct Retired {
+				uint64_t epoch;
+				std::unique_ptr<T> value;
+			};
+
+			// 其他线程在某一边的读者数，当前线程自己的读取不算在内
+			int64_t other_readers(uint64_t side) const {
+				int64_t count = readers_[side].load();
+				for (const SnapshotReadRecord* record = t_snapshot_reads; record; record = record->next) {
+					if (record->cell == this && (record->epoch & 1) == side) {
+						--count;
+					}
+				}
+				return count;
+			}
+			bool held_by_current_thread(const T* value) const {
+				for (const SnapshotReadRecord* record = t_snapshot_reads; record; record = record->next) {
+					if (record->cell == this && record->value == value) {
+						return true;
+					}
+				}
+				return false;
+			}
+
+			// 不阻塞的回收：epoch从e推进到e+1的前提是e-1那一边已经没有读者，
+			// 所以epoch为f时，f-2及更早开始的读取都已结束；f-1开始的读取在f-1那一边计数，那一边清空后也都结束了。
+			// 当前线程自己的读取只持有各自的快照，回收时跳过这些快照即可
+			void reclaim() {
+				if (retired_.empty()) {
+					return;
+				}
+				uint64_t epoch = epoch_.load();
+				if (other_readers((epoch + 1) & 1) == 0) {
+					epoch = epoch_.fetch_add(1) + 1;
+				}
+				const bool previous_done = other_readers((epoch + 1) & 1) == 0;
+				retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [&](const Retired& retired) {
+					const bool finished = retired.epoch + 2 <= epoch || (previous_done && retired.epoch + 1 <= epoch);
+					return finished && !held_by_current_thread(retired.value.get());
+					}), retired_.end());
+			}
+
+			std::atomic<T*> current_{ nullptr };
+			mutable std::atomic<uint64_t> epoch_{ 0 };
+			mutable std::atomic<int64_t> readers_[2]{};
+			std::vector<Retired> retired_;
+		};
+	}
+
+	namespace internal {
+		// 强类型信号的参数传递方式：值类型的参数按const引用传递，不拷贝，所有槽看到同一个值；引用类型的参数原样传递
+		template <typename T>
+		using __signal_param_t = std::conditional_t<std::is_lvalue_reference_v<T>, T, const std::remove_reference_t<T>&>;
+	}
+
+	// 强类型信号：作为成员变量使用，例如 refl::Signal<int, const std::string&> value_changed;
+	// 槽的签名在connect时做编译期检查，emit时参数以引用传给每个槽(值类型的参数是const引用)，不拷贝也不装箱成std::any，参数个数不限。
+	// 和基于名字的CObject::connect互不影响，可以同时使用。多线程下可以同时emit和connect/disconnect，emit不加锁。
+	template <typename... Args>
+	class Signal {
+	public:
+		struct Connection {
+			uint64_t id = 0;
+			explicit operator bool() const { return id != 0; }
+		};
+
+		Signal() = default;
+		// 拷贝对象时不拷贝连接，和QObject的语义一致
+		Signal(const Signal&) {}
+		Signal& operator=(const Signal&) { return *this; }
+
+		// 连接到接收者的成员函数。接收者如果是CObject等由shared_ptr管理的对象，析构后连接自动失效
+		template <typename Receiver, typename Slot>
+		Connection connect(Receiver* receiver, Slot Receiver::* slot) {
+			static_assert(std::is_invocable_v<Slot Receiver::*, Receiver&, internal::__signal_param_t<Args>...>,
+				"slot signature does not match the signal");
+			if (!receiver) {
+				throw std::runtime_error("param is null!");
+			}
+			auto record = make_record([receiver, slot](internal::__signal_param_t<Args>... args) {
+				std::invoke(slot, *receiver, args...);
+				});
+			if constexpr (std::is_base_of_v<std::enable_shared_from_this<IReflectable>, Receiver>) {
+				record.guard = receiver->weak_from_this();
+				record.tracked = true;
+			}
+			return add(std::move(record));
+		}
+		template <typename Receiver, typename Slot>
+		Connection connect(const std::shared_ptr<Receiver>& receiver, Slot Receiver::* slot) {
+			return connect(receiver.get(), slot);
+		}
+
+		// 连接到任意可调用对象
+		template <typename Func>
+		Connection connect(Func&& func) {
+			using FuncType = std::decay_t<Func>;
+			static_assert(std::is_invocable_v<FuncType&, internal::__signal_param_t<Args>...>,
+				"slot signature does not match the signal");
+			return add(make_record(std::forward<Func>(func)));
+		}
+
+		bool disconnect(Connection connection) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			const SlotList* slots = slots_.peek();
+			if (!slots) {
+				return false;
+			}
+			for (const auto& record : *slots) {
+				if (record.id == connection.id && record.connected.load()) {
+					record.connected.store(false);// 直接在当前快照里标记，正在emit的线程立即可见
+					if (++dead_count_ * 2 > slots->size()) {// 断开的超过一半时再重建列表
+						rebuild(nullptr);
+					}
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void emit(internal::__signal_param_t<Args>... args) const {
+			auto snapshot = slots_.read();
+			if (const SlotList* slots = snapshot.get()) {
+				for (const auto& record : *slots) {
+					if (!record.connected.load(std::memory_order_acquire)) {
+						continue;
+					}
+					if (record.tracked) {
+						auto guard = record.guard.lock();// 保证调用期间接收者不会析构
+						if (guard) {
+							record.invoke(record.object, args...);
+						}
+					}
+					else {
+						record.invoke(record.object, args...);
+					}
+				}
+			}
+		}
+		void operator()(internal::__signal_param_t<Args>... args) const {
+			emit(args...);
+		}
+
+		size_t slot_count() const {
+			auto snapshot = slots_.read();
+			const SlotList* slots = snapshot.get();
+			return slots ? static_cast<size_t>(std::count_if(slots->begin(), slots->end(),
+				[](const SlotRecord& record) { return record.connected.load(); })) : 0;
+		}
+
+	private:
+		using Invoker = void(*)(void* object, internal::__signal_param_t<Args>...);
+
+		struct SlotRecord {
+			uint64_t id = 0;
+			void* object = nullptr;
+			Invoker invoke = nullptr;
+			std::shared_ptr<void> storage;// 可调用对象的存储，object指向它
+			std::weak_ptr<void> guard;
+			bool tracked = false;
+			mutable std::atomic<bool> connected{ true };
+
+			SlotRecord() = default;
+			SlotRecord(const SlotRecord& other)
+				: id(other.id), object(other.object), invoke(other.invoke), storage(other.storage),
+				guard(other.guard), tracked(other.tracked), connected(other.connected.load()) {}
+		};
+		using SlotList = std::vector<SlotRecord>;
+
+		template <typename FuncType>
+		static void invoke_functor(void* object, internal::__signal_param_t<Args>... args) {
+			(*static_cast<FuncType*>(object))(args...);
+		}
+
+		template <typename Func>
+		static SlotRecord make_record(Func&& func) {
+			using FuncType = std::decay_t<Func>;
+			auto functor = std::make_shared<FuncType>(std::forward<Func>(func));
+			SlotRecord record;
+			record.object = functor.get();
+			record.invoke = &invoke_functor<FuncType>;
+			record.storage = std::move(functor);
+			return record;
+		}
+
+		Connection add(SlotRecord&& record) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			record.id = ++next_id_;
+			rebuild(&record);
+			return Connection{ record.id };
+		}
+
+		// 复制一份新的槽列表并发布：去掉已断开和接收者已析构的槽，可追加一个新槽。调用方持有mutex_
+		void rebuild(const SlotRecord* appended) {
+			auto next = std::make_unique<SlotList>();
+			if (const SlotList* current = slots_.peek()) {
+				next->reserve(current->size() + 1);
+				for (const auto& record : *current) {
+					if (record.connected.load() && !(record.tracked && record.guard.expired())) {
+						next->push_back(record);
+					}
+				}
+			}
+			if (appended) {
+				next->push_back(*appended);
+			}
+			dead_count_ = 0;
+			slots_.publish(std::move(next));
+		}
+
+		internal::SnapshotCell<SlotList> slots_;
+		std::mutex mutex_;// 只串行connect/disconnect
+		uint64_t next_id_ = 0;
+		size_t dead_count_ = 0;
+	};
+
+	//宏用于类中声明信号，并提供一个同名的方法来触发信号。宏参数是函数参数列表。示例：
+	/*	void x_value_modified(int param) {
+		IMPL_SIGNAL(param);
+	}*/
+#define REFLEC_IMPL_SIGNAL(...) do { \
+		static const ::refl::AtomId __signal_id = ::refl::internal::AtomTable::instance().intern(__func__); \
+		raw_emit_signal_by_id(__signal_id, __VA_ARGS__); \
+	} while (0)
+
+	// 连接类型，含义同Qt
+	enum class ConnectionType {
+		AutoConnection,		// 接收者属于当前线程的事件循环(或者没有事件循环)时直接调用，否则排队
+		DirectConnection,	// 在emit的线程里直接调用槽函数
+		QueuedConnection,	// 投递到接收者所属的事件循环，在事件循环的线程里调用槽函数
+	};
+
+	// CObject在IReflectable的基础上，额外提供信号槽功能的支持。
+	// 信号槽是线程安全的：emit读取连接表的快照，不加锁；connect/disconnect之间用互斥锁串行。
+	class CObject :
+		public refl::IReflectable {
+	public:
+		// connect返回的连接句柄，id带有代数(generation)，连接断开后旧句柄自动失效
+		struct Connection {
+			CObject* sender = nullptr;
+			uint32_t id = 0;
+			uint32_t generation = 0;
+			explicit operator bool() const { return sender != nullptr; }
+		};
+
+		// 对象默认属于构造它的线程上的事件循环
+		CObject() : event_loop_(current_event_loop()) {}
+		// 拷贝对象时不拷贝连接
+		CObject(const CObject& other) : IReflectable(other), event_loop_(current_event_loop()) {}
+		CObject& operator=(const CObject&) { return *this; }
+
+		bool is_qobject() const { return object_kind_ == ObjectKind::QObject; }
+
+		// 属性变化通知：反射属性(assign_field_value、PropertyHandle::set、assign_field_value_by_index)和QObject的动态属性
+		// 赋了不同的值之后，发出信号properties_changed，参数是变化的属性名列表std::vector<std::string_view>。
+		// 在PropertyUpdateBatch的作用域内，每个对象的变化合并成一次通知。没有连接这个信号时什么也不做。
+		static AtomId properties_changed_signal() {
+			static const AtomId id = internal::AtomTable::instance().intern("properties_changed");
+			return id;
+		}
+		void notify_property_changed(std::string_view name);
+
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+		// 对象析构时还在等待信号的协程直接销毁，不会再恢复
+		~CObject() {
+			std::vector<std::coroutine_handle<>> pending;
+			{
+				std::lock_guard<std::mutex> lock(connections_mutex_);
+				for (SignalAwaiter* waiter : signal_waiters_) {
+					pending.push_back(waiter->handle);
+				}
+				signal_waiters_.clear();
+			}
+			for (auto handle : pending) {
+				handle.destroy();
+			}
+		}
+
+		// co_await obj->next_signal("x_value_modified")：下一次emit这个信号时恢复，结果是这次emit的参数。
+		// 在等待时所在的事件循环中恢复，没有事件循环时在emit的线程里恢复
+		struct SignalAwaiter {
+			CObject* sender;
+			AtomId signal_id;
+			base::CEventLoop* loop = nullptr;
+			std::coroutine_handle<> handle;
+			std::vector<std::any> args;
+
+			SignalAwaiter(CObject* sender, AtomId signal_id) : sender(sender), signal_id(signal_id) {}
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> awaiting) {
+				handle = awaiting;
+				loop = current_event_loop();
+				std::lock_guard<std::mutex> lock(sender->connections_mutex_);
+				sender->signal_waiters_.push_back(this);
+				sender->signal_waiter_count_.fetch_add(1, std::memory_order_release);
+				// 解锁后emit可能在别的线程里立即恢复协程，之后不能再访问this
+			}
+			std::vector<std::any> await_resume() { return std::move(args); }
+		};
+		SignalAwaiter next_signal(const char* signal_name) {
+			return SignalAwaiter{ this, internal::AtomTable::instance().intern(signal_name) };
+		}
+#endif
+
+		// 对象所属的事件循环，排队连接的槽函数会投递到这个事件循环中执行
+		base::CEventLoop* eventLoop() const {
+			return event_loop_.load(std::memory_order_acquire);
+		}
+		void moveToEventLoop(base::CEventLoop* loop) {
+			event_loop_.store(loop, std::memory_order_release);
+		}
+
+	protected:
+		// 缓存的类型标记，派生类在构造函数里设置，判断类型时不需要dynamic_cast
+		enum class ObjectKind : uint8_t {
+			Object,
+			QObject,
+		};
+		ObjectKind object_kind_ = ObjectKind::Object;
+
+	private:
+		friend class PropertyUpdateBatch;
+
+		// 有没有连接(或者协程在等待)这个信号，没有时发出信号前不用准备参数
+		bool has_signal_listeners(AtomId signal_id) const {
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+			if (signal_waiter_count_.load(std::memory_order_acquire) != 0) {
+				return true;
+			}
+#endif
+			auto snapshot = connections_.read();
+			const ConnectionTable* table = snapshot.get();
+			return table && table->find(signal_id);
+		}
+		void emit_properties_changed(std::vector<std::string_view> names) {
+			raw_emit_signal_by_id(properties_changed_signal(), std::move(names));
+		}
+
+		// 一个连接：接收者和在connect时就从元信息里取好的槽函数，emit时直接调用，不经过虚函数
+		struct ConnectionInfo {
+			std::weak_ptr<IReflectable> receiver;
+			const MethodInfo* slot = nullptr;
+			uint32_t id = 0;
+			ConnectionType type = ConnectionType::AutoConnection;
+			CObject* receiver_object = nullptr;// 只用于读取接收者的事件循环，调用前必须先lock receiver
+			mutable std::atomic<bool> connected{ true };// disconnect直接在快照里置位，正在emit的线程立即可见
+
+			ConnectionInfo(std::weak_ptr<IReflectable> receiver, const MethodInfo* slot, uint32_t id, ConnectionType type, CObject* receiver_object)
+				: receiver(std::move(receiver)), slot(slot), id(id), type(type), receiver_object(receiver_object) {}
+			ConnectionInfo(const ConnectionInfo& other)
+				: receiver(other.receiver), slot(other.slot), id(other.id), type(other.type),
+				receiver_object(other.receiver_object), connected(other.connected.load()) {}
+			ConnectionInfo& operator=(const ConnectionInfo& other) {
+				receiver = other.receiver;
+				slot = other.slot;
+				id = other.id;
+				type = other.type;
+				receiver_object = other.receiver_object;
+				connected.store(other.connected.load());
+				return *this;
+			}
+		};
+		// 一次emit中投递到同一个事件循环的所有槽调用，作为一个任务执行
+		struct QueuedCall {
+			std::weak_ptr<IReflectable> receiver;
+			const MethodInfo* slot;
+		};
+		template <size_t N>
+		struct QueuedBatch {
+			std::array<std::any, N> args;// 排队的槽共享一份参数拷贝
+			std::vector<QueuedCall> calls;
+		};
+		// 一个信号的所有连接，连续存储，常见的1~4个槽不分配堆内存
+		struct SignalConnections {
+			AtomId signal_id;
+			internal::SmallVector<ConnectionInfo, 4> slots;
+			uint32_t dead_count = 0;// 只有写者访问
+		};
+		// 发布给emit读取的连接表快照。一个对象上的信号通常很少，线性查找连续数组比哈希表更快
+		struct ConnectionTable {
+			std::vector<std::shared_ptr<SignalConnections>> signals;
+
+			SignalConnections* find(AtomId signal_id) const {
+				for (const auto& signal : signals) {
+					if (signal->signal_id == signal_id) {
+						return signal.get();
+					}
+				}
+				return nullptr;
+			}
+		};
+		// 连接id -> 连接所在位置，disconnect通过它O(1)定位。只有写者访问
+		struct ConnectionSlot {
+			uint32_t generation = 0;
+			AtomId signal_id = 0;
+			uint32_t slot_pos = 0;
+			bool in_use = false;
+		};
+		internal::SnapshotCell<ConnectionTable> connections_;
+		std::mutex connections_mutex_;// 只串行connect/disconnect，emit不加锁
+		std::atomic<base::CEventLoop*> event_loop_{ nullptr };
+		std::atomic<bool> properties_changed_connected_{ false };// 连接过properties_changed之后，修改属性时才去查连接表
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+		std::vector<SignalAwaiter*> signal_waiters_;// 由connections_mutex_保护
+		std::atomic<size_t> signal_waiter_count_{ 0 };// emit不加锁先检查它
+
+		// 取出等待这个信号的协程，拷贝参数后恢复
+		void wake_signal_waiters(AtomId signal_id, const std::any* args, size_t count) {
+			std::vector<SignalAwaiter*> woken;
+			{
+				std::lock_guard<std::mutex> lock(connections_mutex_);
+				auto it = std::stable_partition(signal_waiters_.begin(), signal_waiters_.end(),
+					[signal_id](SignalAwaiter* waiter) { return waiter->signal_id != signal_id; });
+				woken.assign(it, signal_waiters_.end());
+				signal_waiters_.erase(it, signal_waiters_.end());
+				signal_waiter_count_.fetch_sub(woken.size(), std::memory_order_relaxed);
+			}
+			for (SignalAwaiter* waiter : woken) {
+				waiter->args.assign(args, args + count);
+				base::CEventLoop* loop = waiter->loop;
+				std::coroutine_handle<> handle = waiter->handle;// 恢复之后waiter可能已经随协程帧销毁
+				if (loop) {
+					post_to_event_loop(loop, [handle] { handle.resume(); });
+				}
+				else {
+					handle.resume();
+				}
+			}
+		}
+#endif
+
+		// 这两个函数依赖CEventLoop的完整定义，实现在CEventLoop之后
+		static base::CEventLoop* current_event_loop();
+		static void post_to_event_loop(base::CEventLoop* loop, base::CTask task);
+
+		// 判断这个连接本次emit是否需要排队，返回需要投递到的事件循环
+		static base::CEventLoop* queued_target(const ConnectionInfo& slot_info) {
+			if (slot_info.type == ConnectionType::DirectConnection) {
+				return nullptr;
+			}
+			base::CEventLoop* target = slot_info.receiver_object->eventLoop();
+			if (slot_info.type == ConnectionType::AutoConnection && target == current_event_loop()) {
+				return nullptr;
+			}
+			return target;// 接收者没有事件循环时只能直接调用
+		}
+		std::vector<ConnectionSlot> connection_slots_;
+		std::vector<uint32_t> free_connection_ids_;
+
+		// 以下函数调用方必须持有connections_mutex_
+		uint32_t allocate_connection_id() {
+			uint32_t id;
+			if (!free_connection_ids_.empty()) {
+				id = free_connection_ids_.back();
+				free_connection_ids_.pop_back();
+			}
+			else {
+				id = static_cast<uint32_t>(connection_slots_.size());
+				connection_slots_.emplace_back();
+			}
+			connection_slots_[id].in_use = true;
+			return id;
+		}
+
+		void release_connection_id(uint32_t id) {
+			auto& slot = connection_slots_[id];
+			slot.in_use = false;
+			++slot.generation;// 旧句柄失效
+			free_connection_ids_.push_back(id);
+		}
+
+		// 复制一份新的连接表并发布，其中signal_id对应的列表重新生成：去掉已断开和接收者已析构的连接，可追加一个新连接
+		void rebuild_signal(AtomId signal_id, const ConnectionInfo* appended) {
+			const ConnectionTable* current = connections_.peek();
+			auto next = current ? std::make_unique<ConnectionTable>(*current) : std::make_unique<ConnectionTable>();
+			auto list = std::make_shared<SignalConnections>();
+			list->signal_id = signal_id;
+
+			auto it = std::find_if(next->signals.begin(), next->signals.end(),
+				[signal_id](const auto& signal) { return signal->signal_id == signal_id; });
+			if (it != next->signals.end()) {
+				for (const auto& info : (*it)->slots) {
+					if (!info.connected.load()) {
+						continue;// disconnect时已经释放了id
+					}
+					if (info.receiver.expired()) {
+						release_connection_id(info.id);
+						continue;
+					}
+					connection_slots_[info.id].slot_pos = static_cast<uint32_t>(list->slots.size());
+					list->slots.push_back(info);
+				}
+			}
+			if (appended) {
+				connection_slots_[appended->id].slot_pos = static_cast<uint32_t>(list->slots.size());
+				list->slots.push_back(*appended);
+			}
+
+			if (it != next->signals.end()) {
+				if (list->slots.empty()) {
+					next->signals.erase(it);
+				}
+				else {
+					*it = std::move(list);
+				}
+			}
+			else if (!list->slots.empty()) {
+				next->signals.push_back(std::move(list));
+			}
+			connections_.publish(std::move(next));
+		}
+
+	public:
+		template<typename... Args>
+		void raw_emit_signal_by_id(AtomId signal_id, Args&&... args) {
+			// 无锁读取连接表快照，槽函数里的connect/disconnect不影响本次emit正在遍历的这份快照
+			auto snapshot = connections_.read();
+			const ConnectionTable* table = snapshot.get();
+			const SignalConnections* signal = table ? table->find(signal_id) : nullptr;
+			constexpr size_t N = sizeof...(Args);
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+			if (signal_waiter_count_.load(std::memory_order_acquire) != 0) {
+				const std::array<std::any, N> waiter_args{ std::any(args)... };
+				wake_signal_waiters(signal_id, waiter_args.data(), N);
+			}
+#endif
+			if (!signal) {
+				return;/*没找到这个信号，要不要assert？*/
+			}
+			// 参数只装箱一次。槽函数可以修改或者移走std::any&参数，所以每个直接调用的槽拿到一份拷贝，
+			// 最后一个槽之后不再需要这份参数，直接交给它
+			std::array<std::any, N> argv{ std::any(std::forward<Args>(args))... };
+			// 排队的调用按目标事件循环分组，一次emit对每个事件循环只投递一个任务。通常只有一个目标
+			base::CEventLoop* queued_loop = nullptr;
+			std::unique_ptr<QueuedBatch<N>> queued;
+			for (const auto& slot_info : signal->slots) {
+				if (!slot_info.connected.load(std::memory_order_acquire)) {
+					continue;
+				}
+				auto ptr = slot_info.receiver.lock(); // 锁定弱引用，接收者已经析构的连接在下次connect/disconnect时清理
+				if (!ptr) {
+					continue;
+				}
+				base::CEventLoop* target = queued_target(slot_info);
+				if (!target) {
+					if (&slot_info + 1 == signal->slots.end()) {
+						slot_info.slot->invoke(*ptr, argv.data(), argv.size());
+					}
+					else {
+						auto slot_args = argv;
+						slot_info.slot->invoke(*ptr, slot_args.data(), slot_args.size());
+					}
+					continue;
+				}
+				if (queued && queued_loop != target) {
+					post_queued_batch(queued_loop, std::move(queued));
+				}
+				if (!queued) {
+					queued = std::make_unique<QueuedBatch<N>>(QueuedBatch<N>{ argv, {} });
+					queued_loop = target;
+				}
+				queued->calls.push_back({ slot_info.receiver, slot_info.slot });
+			}
+			if (queued) {
+				post_queued_batch(queued_loop, std::move(queued));
+			}
+		}
+
+		template <size_t N>
+		static void post_queued_batch(base::CEventLoop* loop, std::unique_ptr<QueuedBatch<N>> batch) {
+			post_to_event_loop(loop, [batch = std::move(batch)]{
+				for (const auto& call : batch->calls) {
+					if (auto ptr = call.receiver.lock()) {
+						auto args = batch->args;// 每个槽拿到一份新的参数，和直接调用时一样
+						call.slot->invoke(*ptr, args.data(), args.size());
+					}
+				}
+				});
+		}
+
+		template<typename... Args>
+		void raw_emit_signal_impl(const char* signal_name, Args&&... args) {
+			const AtomId signal_id = internal::AtomTable::instance().find(signal_name);
+			if (signal_id != internal::AtomTable::invalid_atom) {// 从来没connect过的信号不会有id
+				raw_emit_signal_by_id(signal_id, std::forward<Args>(args)...);
+			}
+		}
+
+		Connection connect(const char* signal_name, refl::CObject* slot_instance, const char* slot_member_func_name,
+			ConnectionType type = ConnectionType::AutoConnection) {
+			if (!slot_instance || !signal_name || !slot_member_func_name) {
+				throw std::runtime_error("param is null!");
+			}
+			assert(slot_instance->weak_from_this().lock());//target必须通过make_share构造！！因为要弱引用它
+
+			const TypeInfo& slot_meta = slot_instance->meta();
+			const size_t slot_index = slot_meta.method_index.find(slot_member_func_name);
+			if (slot_index == invalid_index) {
+				throw std::runtime_error("slot_member_func_name is not found!");
+			}
+			const AtomId signal_id = internal::AtomTable::instance().intern(signal_name);
+
+			std::lock_guard<std::mutex> lock(connections_mutex_);
+			const uint32_t id = allocate_connection_id();
+			auto& slot = connection_slots_[id];
+			slot.signal_id = signal_id;
+			const ConnectionInfo info(slot_instance->weak_from_this(), &slot_meta.methods[slot_index], id, type, slot_instance);
+			rebuild_signal(signal_id, &info);
+			if (signal_id == properties_changed_signal()) {
+				properties_changed_connected_.store(true, std::memory_order_release);
+			}
+			return Connection{ this, id, slot.generation };
+		}
+		template <typename SlotClass>
+		Connection connect(const char* signal_name, std::shared_ptr<SlotClass> slot_instance, const char* slot_member_func_name,
+			ConnectionType type = ConnectionType::AutoConnection) {
+			return connect(signal_name, slot_instance.get(), slot_member_func_name, type);
+		}
+
+		template <typename SignalClass, typename SignalType, typename SlotClass, typename SlotType>
+		Connection connect(SignalType SignalClass::* signal, SlotClass* slot_instance, SlotType SlotClass::* slot,
+			ConnectionType type = ConnectionType::AutoConnection) {
+			const char* signal_name = get_member_func_name<SignalClass>(signal);
+			const char* slot_name = get_member_func_name<SlotClass>(slot);
+			if (signal_name && slot_name) {
+				return connect(signal_name, static_cast<CObject*>(slot_instance), slot_name, type);
+			}
+			throw std::runtime_error("signal name or slot_name is not found!");
+		}
+		template <typename SignalClass, typename SignalType, typename SlotClass, typename SlotType>
+		Connection connect(SignalType SignalClass::* signal, std::shared_ptr<SlotClass>& slot_instance, SlotType SlotClass::* slot,
+			ConnectionType type = ConnectionType::AutoConnection) {
+			return connect(signal, slot_instance.get(), slot, type);
+		}
+
+		bool disconnect(const Connection& connection) {
+			if (connection.sender != this) {
+				return false;//不是我的connection呀
+			}
+			std::lock_guard<std::mutex> lock(connections_mutex_);
+			if (connection.id >= connection_slots_.size()) {
+				return false;
+			}
+			const auto slot = connection_slots_[connection.id];
+			if (!slot.in_use || slot.generation != connection.generation) {
+				return false;// 已经断开过了
+			}
+			SignalConnections* signal = connections_.peek()->find(slot.signal_id);
+			auto& info = signal->slots[slot.slot_pos];
+			assert(info.id == connection.id);
+			info.connected.store(false);
+			release_connection_id(connection.id);
+			if (++signal->dead_count * 2 > signal->slots.size()) {// 断开的连接超过一半时再重建，disconnect均摊O(1)
+				rebuild_signal(slot.signal_id, nullptr);
+			}
+			return true;
+		}
+	};
+
+	// 批量修改属性：作用域内的属性变化按对象合并，作用域结束时每个对象只发出一次properties_changed，列出变化过的属性。
+	// 可以嵌套，由最外层的作用域发出通知。只合并当前线程上、由shared_ptr管理的对象的修改，其他对象无法确认作用域结束时是否还存活，照常直接通知。
+	class PropertyUpdateBatch {
+	public:
+		PropertyUpdateBatch() {
+			if (!s_current) {
+				s_current = this;
+			}
+		}
+		~PropertyUpdateBatch() {
+			if (s_current != this) {
+				return;
+			}
+			s_current = nullptr;// 槽函数里再修改属性时直接通知
+			for (auto& pending : pending_) {
+				if (auto owner = pending.owner.lock()) {
+					pending.object->emit_properties_changed(std::move(pending.names));
+				}
+			}
+		}
+		PropertyUpdateBatch(const PropertyUpdateBatch&) = delete;
+		PropertyUpdateBatch& operator=(const PropertyUpdateBatch&) = delete;
+
+		// 当前线程有批量修改时记录下来，返回false表示需要直接通知
+		static bool record(CObject* object, std::string_view name);
+
+	private:
+		struct Pending {
+			CObject* object;
+			std::weak_ptr<IReflectable> owner;// 作用域结束前对象可能已经析构
+			std::vector<std::string_view> names;
+		};
+		std::vector<Pending> pending_;
+		std::unordered_map<CObject*, size_t> index_;
+		size_t last_ = 0;// 上一次记录的对象
+		static thread_local PropertyUpdateBatch* s_current;
+	};
+
+	inline bool PropertyUpdateBatch::record(CObject* object, std::string_view name) {
+		PropertyUpdateBatch* batch = s_current;
+		if (!batch) {
+			return false;
+		}
+		if (batch->last_ < batch->pending_.size() && batch->pending_[batch->last_].object == object) {// 通常连续修改同一个对象
+			Pending& pending = batch->pending_[batch->last_];
+			if (!pending.owner.expired()) {
+				if (std::find(pending.names.begin(), pending.names.end(), name) == pending.names.end()) {
+					pending.names.push_back(name);
+				}
+				return true;
+			}
+		}
+		auto it = batch->index_.find(object);
+		if (it != batch->index_.end()) {
+			Pending& pending = batch->pending_[it->second];
+			if (!pending.owner.expired()) {
+				batch->last_ = it->second;
+				if (std::find(pending.names.begin(), pending.names.end(), name) == pending.names.end()) {
+					pending.names.push_back(name);
+				}
+				return true;
+			}
+		}
+		std::weak_ptr<IReflectable> owner = object->weak_from_this();
+		if (owner.expired()) {// 不是由shared_ptr管理(或者正在析构)，作用域结束时无法确认它还存活
+			return false;
+		}
+		if (it != batch->index_.end()) {
+			it->second = batch->pending_.size();// 原来的对象已经析构，地址被新对象复用
+		}
+		else {
+			batch->index_.emplace(object, batch->pending_.size());
+		}
+		batch->last_ = batch->pending_.size();
+		batch->pending_.push_back(Pending{ object, std::move(owner), { name } });
+		return true;
+	}
+
+	inline void CObject::notify_property_changed(std::string_view name) {
+		bool maybe_listened = properties_changed_connected_.load(std::memory_order_acquire);
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+		maybe_listened = maybe_listened || signal_waiter_count_.load(std::memory_order_acquire) != 0;
+#endif
+		if (!maybe_listened || PropertyUpdateBatch::record(this, name)) {
+			return;// 批量修改时在作用域结束时再检查连接
+		}
+		if (has_signal_listeners(properties_changed_signal())) {
+			emit_properties_changed({ name });
+		}
+	}
+
+	class QObjectSnapshot;
+	namespace internal {
+		struct SnapshotTree;
+		// 从快照创建的QObject对应的节点，子树还有没创建的对象时才有
+		struct SnapshotLink {
+			std::shared_ptr<SnapshotTree> tree;
+			uint32_t node;
+			bool childrenLoaded;
+		};
+	}
+
+	// QObject在CObject的基础上，提供父子关系、动态属性的支持。
+	// 动态属性的名字在全局驻留表里转换为id，每个对象的属性按id排序连续存放，查找不分配内存。
+	// 子对象连续存放；每个对象维护直接子对象和整个子树的名字索引，findChild/findChildRecursively都是一次哈希查找。
+	// 名字索引里同名的对象按深度优先顺序排列，查找结果和逐个遍历时一致。空名字不参与查找。
+	class QObject : public CObject {
+	private:
+		friend class ObjectWriter;
+		friend class QObjectSnapshot;
+		friend struct internal::SnapshotTree;
+		using NameIndex = std::pmr::unordered_map<AtomId, std::pmr::vector<QObject*>>;
+
+		std::string objectName_;
+		AtomId nameAtom_ = internal::AtomTable::invalid_atom;
+		QObject* parent_ = nullptr;// 父对象持有子对象的shared_ptr，父对象析构时清空子对象的parent_
+		uint32_t indexInParent_ = 0;// 在父对象children_中的下标，压缩children_时更新，顺序不变
+		struct DynamicProperty {
+			AtomId id;
+			std::string_view name;// 指向驻留表里的字符串，发出变化通知时使用
+			std::any value;
+		};
+		std::pmr::vector<DynamicProperty> dynamicProperties_;// 按id排序
+		std::pmr::vector<std::shared_ptr<QObject>> children_;// 移除的子对象先置空，空位超过一半时再压缩
+		size_t deadChildren_ = 0;
+		NameIndex childrenByName_;
+		NameIndex descendantsByName_;// 不包含自己
+		std::unique_ptr<internal::SnapshotLink> snapshot_;// 见QObjectSnapshot，子对象在第一次访问时才创建
+	public:
+		// 用QObjectArena::make创建时，内部容器也从对象池分配
+		QObject() : QObject(QObjectArena::take_current_resource()) {}
+		// 拷贝对象时只拷贝名字和动态属性，不拷贝父子关系
+		QObject(const QObject& other) : QObject(QObjectArena::take_current_resource()) {
+			dynamicProperties_ = other.dynamicProperties_;
+			setObjectName(other.objectName_.c_str());
+		}
+		QObject& operator=(const QObject& other) {
+			if (this != &other) {
+				setObjectName(other.objectName_.c_str());
+				dynamicProperties_ = other.dynamicProperties_;
+			}
+			return *this;
+		}
+		~QObject() {
+			for (auto& child : children_) {
+				if (child) {
+					child->parent_ = nullptr;
+				}
+			}
+		}
+
+		void setObjectName(const char* name) {
+			const AtomId atom = *name ? internal::AtomTable::instance().intern(name) : internal::AtomTable::invalid_atom;
+			if (atom == nameAtom_) {
+				return;
+			}
+			update_ancestor_indexes(false, true);
+			objectName_ = name;
+			nameAtom_ = atom;
+			update_ancestor_indexes(true, true);
+		}
+		const std::string& getObjectName() const {
+			return objectName_;
+		}
+
+		void setParent(QObject* newParent) {
+			if (newParent == parent_) {
+				return;
+			}
+			for (QObject* ancestor = newParent; ancestor; ancestor = ancestor->parent_) {
+				if (ancestor == this) {
+					return;// 不能挂到自己的子树下
+				}
+			}
+			if (snapshot_) {
+				load_snapshot_subtree();// 移动的子树里不能留下还没创建的对象
+			}
+			if (newParent && newParent->snapshot_) {
+				newParent->load_snapshot_children();
+			}
+			std::shared_ptr<QObject> self;// 脱离父对象时可能是最后一个引用，函数返回时才释放
+			if (parent_) {
+				update_ancestor_indexes(false, false);
+				self = parent_->take_child(indexInParent_);
+				parent_ = nullptr;
+			}
+			else {
+				self = std::static_pointer_cast<QObject>(shared_from_this());
+			}
+			if (newParent) {
+				parent_ = newParent;
+				indexInParent_ = static_cast<uint32_t>(newParent->children_.size());
+				newParent->children_.push_back(std::move(self));
+				update_ancestor_indexes(true, false);
+			}
+		}
+		template <typename T>
+		void setParent(std::shared_ptr<T> newParent) {
+			setParent(newParent.get());
+		}
+
+		void removeChild(CObject* child) {
+			QObject* qChild = qobject_cast(child);
+			if (qChild && qChild->parent_ == this) {
+				qChild->setParent(nullptr);
+			}
+		}
+		CObject* findChild(const char* name) {
+			if (snapshot_) {
+				load_snapshot_children();
+			}
+			return find_in(childrenByName_, name);
+		}
+		CObject* findChildRecursively(const char* name) {
+			if (snapshot_) {
+				load_snapshot_match(name);
+			}
+			return find_in(descendantsByName_, name);
+		}
+		// 按加入的顺序遍历直接子对象
+		template <typename Func>
+		void forEachChild(Func&& func) const {
+			if (snapshot_) {
+				const_cast<QObject*>(this)->load_snapshot_children();
+			}
+			for (const auto& child : children_) {
+				if (child) {
+					func(child.get());
+				}
+			}
+		}
+
+		// 用缓存的类型标记代替dynamic_cast
+		static QObject* qobject_cast(CObject* object) {
+			return object && object->is_qobject() ? static_cast<QObject*>(object) : nullptr;
+		}
+
+		// 属性名转换为id，频繁访问的属性可以先取得id再用id读写
+		static AtomId propertyId(const char* name) {
+			return internal::AtomTable::instance().intern(name);
+		}
+
+		// 属性不存在时返回空的std::any，不会插入新属性
+		const std::any& getProperty(const char* name) const {
+			return getProperty(internal::AtomTable::instance().find(name));
+		}
+		const std::any& getProperty(AtomId id) const {
+			static const std::any empty;
+			const std::any* value = find_property(id);
+			return value ? *value : empty;
+		}
+		// 属性不存在或者类型不是T时返回nullptr
+		template<typename T>
+		const T* getProperty(const char* name) const {
+			return getProperty<T>(internal::AtomTable::instance().find(name));
+		}
+		template<typename T>
+		const T* getProperty(AtomId id) const {
+			const std::any* value = find_property(id);
+			return value ? std::any_cast<T>(value) : nullptr;
+		}
+
+		// 设置为空的std::any时删除属性。属性变化时发出properties_changed，见CObject::notify_property_changed；
+		// std::any版本无法比较新旧值，总是通知
+		void setProperty(const char* name, const std::any& value) {
+			setProperty(value.has_value() ? propertyId(name) : internal::AtomTable::instance().find(name), value);
+		}
+		void setProperty(AtomId id, const std::any& value) {
+			if (value.has_value()) {
+				DynamicProperty& property = property_slot(id);
+				property.value = value;
+				notify_property_changed(property.name);
+			}
+			else {
+				remove_property(id);
+			}
+		}
+		// 按类型直接在属性里构造值，不经过临时的std::any；标量和字符串赋同样的值时不通知
+		template<typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, std::any>>>
+		void setProperty(const char* name, T&& value) {
+			setProperty(propertyId(name), std::forward<T>(value));
+		}
+		template<typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, std::any>>>
+		void setProperty(AtomId id, T&& value) {
+			using Value = std::decay_t<T>;
+			DynamicProperty& property = property_slot(id);
+			if (auto* current = std::any_cast<Value>(&property.value)) {
+				if constexpr (internal::__is_cheaply_comparable<Value, Value>::value) {
+					if (*current == value) {
+						return;
+					}
+				}
+				*current = std::forward<T>(value);
+			}
+			else {
+				property.value.emplace<Value>(std::forward<T>(value));
+			}
+			notify_property_changed(property.name);
+		}
+
+	private:
+		explicit QObject(std::pmr::memory_resource* resource)
+			: dynamicProperties_(resource), children_(resource), childrenByName_(resource), descendantsByName_(resource) {
+			object_kind_ = ObjectKind::QObject;
+		}
+
+		std::pmr::vector<DynamicProperty>::iterator lower_bound_property(AtomId id) {
+			return std::lower_bound(dynamicProperties_.begin(), dynamicProperties_.end(), id,
+				[](const DynamicProperty& property, AtomId key) { return property.id < key; });
+		}
+		const std::any* find_property(AtomId id) const {
+			auto it = const_cast<QObject*>(this)->lower_bound_property(id);
+			return it != dynamicProperties_.end() && it->id == id ? &it->value : nullptr;
+		}
+		DynamicProperty& property_slot(AtomId id) {
+			auto it = lower_bound_property(id);
+			if (it == dynamicProperties_.end() || it->id != id) {
+				it = dynamicProperties_.insert(it, DynamicProperty{ id, internal::AtomTable::instance().name(id), std::any() });
+			}
+			return *it;
+		}
+		void remove_property(AtomId id) {
+			auto it = lower_bound_property(id);
+			if (it != dynamicProperties_.end() && it->id == id) {
+				const std::string_view name = it->name;
+				dynamicProperties_.erase(it);
+				notify_property_changed(name);
+			}
+		}
+
+		static CObject* find_in(const NameIndex& index, const char* name) {
+			if (index.empty()) {
+				return nullptr;
+			}
+			auto it = index.find(internal::AtomTable::instance().find(name));
+			return it != index.end() ? it->second.front() : nullptr;
+		}
+
+		// 两个对象在同一棵树上，a按深度优先顺序是否排在b前面
+		static bool dfs_before(const QObject* a, const QObject* b) {
+			size_t depthA = 0, depthB = 0;
+			for (const QObject* p = a->parent_; p; p = p->parent_) ++depthA;
+			for (const QObject* p = b->parent_; p; p = p->parent_) ++depthB;
+			for (; depthA > depthB; --depthA) {
+				a = a->parent_;
+				if (a == b) {
+					return false;// b是a的祖先
+				}
+			}
+			for (; depthB > depthA; --depthB) {
+				b = b->parent_;
+				if (b == a) {
+					return true;
+				}
+			}
+			if (a == b) {
+				return false;
+			}
+			while (a->parent_ != b->parent_) {
+				a = a->parent_;
+				b = b->parent_;
+			}
+			return a->indexInParent_ < b->indexInParent_;
+		}
+
+		// 子树在深度优先顺序上是连续的，同名的一组对象可以整段插入或删除
+		static void update_bucket(NameIndex& index, AtomId atom, QObject* const* first, size_t count, bool insert) {
+			auto& bucket = index[atom];
+			auto pos = std::lower_bound(bucket.begin(), bucket.end(), *first, dfs_before);
+			if (insert) {
+				bucket.insert(pos, first, first + count);
+			}
+			else {
+				bucket.erase(pos, pos + count);
+				if (bucket.empty()) {
+					index.erase(atom);
+				}
+			}
+		}
+
+		// 把自己(onlySelf为false时连同整个子树)的名字加入或移出父对象和所有祖先的索引。
+		// 插入时自己必须已经挂在新位置上，删除时必须还在原来的位置上。
+		void update_ancestor_indexes(bool insert, bool onlySelf) {
+			if (!parent_) {
+				return;
+			}
+			QObject* self = this;
+			if (nameAtom_ != internal::AtomTable::invalid_atom) {
+				update_bucket(parent_->childrenByName_, nameAtom_, &self, 1, insert);
+			}
+			if (onlySelf || descendantsByName_.empty()) {
+				if (nameAtom_ != internal::AtomTable::invalid_atom) {
+					for (QObject* ancestor = parent_; ancestor; ancestor = ancestor->parent_) {
+						update_bucket(ancestor->descendantsByName_, nameAtom_, &self, 1, insert);
+					}
+				}
+				return;
+			}
+			// 自己排在所有后代前面，和同名的后代合成一段处理
+			std::vector<QObject*> selfGroup{ self };
+			if (auto it = descendantsByName_.find(nameAtom_); it != descendantsByName_.end()) {
+				selfGroup.insert(selfGroup.end(), it->second.begin(), it->second.end());
+			}
+			for (QObject* ancestor = parent_; ancestor; ancestor = ancestor->parent_) {
+				for (const auto& [atom, bucket] : descendantsByName_) {
+					if (atom != nameAtom_) {
+						update_bucket(ancestor->descendantsByName_, atom, bucket.data(), bucket.size(), insert);
+					}
+				}
+				if (nameAtom_ != internal::AtomTable::invalid_atom) {
+					update_bucket(ancestor->descendantsByName_, nameAtom_, selfGroup.data(), selfGroup.size(), insert);
+				}
+			}
+		}
+
+		// 从快照创建子对象，定义在QObjectSnapshot后面
+		void load_snapshot_children();
+		void load_snapshot_match(const char* name);
+		void load_snapshot_subtree();
+		// 刚创建的对象直接加到子对象末尾
+		void attach_child(std::shared_ptr<QObject> child) {
+			QObject* object = child.get();
+			object->parent_ = this;
+			object->indexInParent_ = static_cast<uint32_t>(children_.size());
+			children_.push_back(std::move(child));
+			object->update_ancestor_indexes(true, false);
+		}
+
+		std::shared_ptr<QObject> take_child(uint32_t index) {
+			std::shared_ptr<QObject> child = std::move(children_[index]);
+			if (index + 1 == children_.size()) {
+				children_.pop_back();
+				while (!children_.empty() && !children_.back()) {
+					children_.pop_back();
+					--deadChildren_;
+				}
+			}
+			else if (++deadChildren_ * 2 > children_.size()) {
+				uint32_t out = 0;
+				for (auto& slot : children_) {
+					if (slot) {
+						slot->indexInParent_ = out;
+						if (&children_[out] != &slot) {
+							children_[out] = std::move(slot);
+						}
+						++out;
+					}
+				}
+				children_.resize(out);
+				deadChildren_ = 0;
+			}
+			return child;
+		}
+	};
+
+	// 对象树的二进制流。流的开头是魔数和版本号，之后是任意多条对象记录，每条记录依次是：
+	// 类型引用、反射字段(encode_binary)、对象名、动态属性、子对象个数和子对象的记录。
+	// 类型和动态属性名在同一个流里只写一次全名，之后只写编号；第一次出现的类型还带有字段结构的哈希，读取时校验
+	class ObjectWriter {
+	public:
+		static constexpr uint32_t kMagic = 0x424f5153;// "SQOB"
+		static constexpr uint8_t kVersion = 1;
+
+		explicit ObjectWriter(BinaryWriter& out) : out_(out) {
+			out_.write(kMagic);
+			out_.write(kVersion);
+		}
+
+		// 写入对象和它的整个子树。类型的字段不支持二进制序列化、或者动态属性的类型不支持时抛出std::runtime_error
+		void write(const QObject& object) {
+			if (object.snapshot_) {
+				const_cast<QObject&>(object).load_snapshot_children();
+			}
+			const TypeInfo& info = object.meta();
+			if (!info.encode) {
+				throw std::runtime_error("type is not binary serializable!");
+			}
+			write_type(info);
+			info.encode(object, out_);
+			out_.write_string(object.objectName_);
+			out_.write_varint(object.dynamicProperties_.size());
+			for (const auto& property : object.dynamicProperties_) {
+				write_property_name(property.id, property.name);
+				write_value(out_, property.value);
+			}
+			out_.write_varint(object.children_.size() - object.deadChildren_);
+			for (const auto& child : object.children_) {
+				if (child) {
+					write(*child);
+				}
+			}
+		}
+
+		// 动态属性支持的值类型，其他类型抛出std::runtime_error
+		enum class ValueTag : uint8_t { Bool = 1, Int32, UInt32, Int64, UInt64, Float, Double, String };
+
+		// 写入一个动态属性的值：类型标记和值。快照使用同样的编码
+		static void write_value(BinaryWriter& out, const std::any& value) {
+			if (!(write_value_as<int32_t>(out, value, ValueTag::Int32) || write_value_as<double>(out, value, ValueTag::Double) ||
+				write_value_as<std::string>(out, value, ValueTag::String) || write_value_as<bool>(out, value, ValueTag::Bool) ||
+				write_value_as<int64_t>(out, value, ValueTag::Int64) || write_value_as<uint32_t>(out, value, ValueTag::UInt32) ||
+				write_value_as<uint64_t>(out, value, ValueTag::UInt64) || write_value_as<float>(out, value, ValueTag::Float))) {
+				throw std::runtime_error("dynamic property type is not binary serializable!");
+			}
+		}
+
+	private:
+		void write_type(const TypeInfo& info) {
+			if (&info == last_type_) {
+				out_.write_varint(last_type_ref_);
+				return;
+			}
+			auto [it, inserted] = types_.try_emplace(&info, static_cast<uint32_t>(types_.size()));
+			out_.write_varint(it->second);
+			if (inserted) {
+				out_.write_string(info.name);
+				out_.write(info.schema_hash);
+			}
+			last_type_ = &info;
+			last_type_ref_ = it->second;
+		}
+		void write_property_name(AtomId id, std::string_view name) {
+			if (id >= names_.size()) {
+				names_.resize(id + 1, kNoRef);
+			}
+			if (names_[id] != kNoRef) {
+				out_.write_varint(names_[id]);
+				return;
+			}
+			names_[id] = name_count_++;
+			out_.write_varint(names_[id]);
+			out_.write_string(name);
+		}
+		template <typename T>
+		static bool write_value_as(BinaryWriter& out, const std::any& value, ValueTag tag) {
+			if (auto typed = std::any_cast<T>(&value)) {
+				out.write(static_cast<uint8_t>(tag));
+				out.write(*typed);
+				return true;
+			}
+			return false;
+		}
+
+		static constexpr uint32_t kNoRef = static_cast<uint32_t>(-1);
+
+		BinaryWriter& out_;
+		std::unordered_map<const TypeInfo*, uint32_t> types_;
+		const TypeInfo* last_type_ = nullptr;// 连续写入同一类型的对象时不查表
+		uint32_t last_type_ref_ = 0;
+		std::vector<uint32_t> names_;// 下标是属性名的AtomId
+		uint32_t name_count_ = 0;
+	};
+
+	// 读取ObjectWriter写入的流：对象按类型名通过TypeRegistry创建(可以指定memory_resource，比如对象池)，字段直接解码到实例里。
+	// 类型没有注册、字段结构和写入时不一致或者数据损坏时抛出std::runtime_error
+	class ObjectReader {
+	public:
+		explicit ObjectReader(BinaryReader& in, std::pmr::memory_resource* resource = nullptr) : in_(in), resource_(resource) {
+			if (in_.read<uint32_t>() != ObjectWriter::kMagic || in_.read<uint8_t>() != ObjectWriter::kVersion) {
+				throw std::runtime_error("binary data is not an object stream!");
+			}
+		}
+
+		bool at_end() const { return in_.at_end(); }
+
+		// 读出下一个对象和它的整个子树
+		std::shared_ptr<QObject> read() {
+			return read_object(nullptr);
+		}
+
+		// 读出ObjectWriter::write_value写入的值，设置为对象的动态属性
+		static void read_value(BinaryReader& in, QObject& object, AtomId id) {
+			switch (static_cast<ObjectWriter::ValueTag>(in.read<uint8_t>())) {
+			case ObjectWriter::ValueTag::Bool: object.setProperty(id, in.read<bool>()); break;
+			case ObjectWriter::ValueTag::Int32: object.setProperty(id, in.read<int32_t>()); break;
+			case ObjectWriter::ValueTag::UInt32: object.setProperty(id, in.read<uint32_t>()); break;
+			case ObjectWriter::ValueTag::Int64: object.setProperty(id, in.read<int64_t>()); break;
+			case ObjectWriter::ValueTag::UInt64: object.setProperty(id, in.read<uint64_t>()); break;
+			case ObjectWriter::ValueTag::Float: object.setProperty(id, in.read<float>()); break;
+			case ObjectWriter::ValueTag::Double: object.setProperty(id, in.read<double>()); break;
+			case ObjectWriter::ValueTag::String: object.setProperty(id, std::string(in.read_string())); break;
+			default: throw std::runtime_error("binary data has a bad property value!");
+			}
+		}
+
+	private:
+		struct TypeEntry {
+			TypeId id;
+			const TypeInfo* info;
+			bool checked;// 第一次创建出对象后确认它是QObject，之后直接转换
+		};
+
+		std::shared_ptr<QObject> read_object(QObject* parent) {
+			TypeEntry& type = read_type();
+			std::shared_ptr<IReflectable> created = internal::TypeRegistry::instance().create(type.id, resource_);
+			QObject* object = nullptr;
+			if (type.checked) {
+				object = static_cast<QObject*>(static_cast<CObject*>(created.get()));
+			}
+			else if ((object = dynamic_cast<QObject*>(created.get())) == nullptr) {
+				throw std::runtime_error("type is not a QObject!");
+			}
+			type.checked = true;
+			type.info->decode(*object, in_);
+			const std::string_view name = in_.read_string();
+			if (!name.empty()) {
+				scratch_.assign(name);
+				object->setObjectName(scratch_.c_str());
+			}
+			for (size_t count = in_.read_count(2); count > 0; --count) {
+				const AtomId id = read_property_name();
+				read_value(in_, *object, id);
+			}
+			std::shared_ptr<QObject> result(std::move(created), object);
+			if (parent) {
+				object->setParent(parent);
+			}
+			for (size_t count = in_.read_count(); count > 0; --count) {
+				read_object(object);
+			}
+			return result;
+		}
+
+		TypeEntry& read_type() {
+			const uint64_t ref = in_.read_varint();
+			if (ref < types_.size()) {
+				return types_[static_cast<size_t>(ref)];
+			}
+			if (ref != types_.size()) {
+				throw std::runtime_error("binary data has a bad type reference!");
+			}
+			const std::string_view name = in_.read_string();
+			const uint32_t schema_hash = in_.read<uint32_t>();
+			auto& registry = internal::TypeRegistry::instance();
+			const TypeId id = registry.resolve(name);
+			const TypeInfo* info = registry.type_info(id);
+			if (!info || !info->decode) {
+				throw std::runtime_error("type in binary data is not registered!");
+			}
+			if (info->schema_hash != schema_hash) {
+				throw std::runtime_error("type in binary data has different fields!");
+			}
+			return types_.emplace_back(TypeEntry{ id, info, false });
+		}
+
+		AtomId read_property_name() {
+			const uint64_t ref = in_.read_varint();
+			if (ref < names_.size()) {
+				return names_[static_cast<size_t>(ref)];
+			}
+			if (ref != names_.size()) {
+				throw std::runtime_error("binary data has a bad property reference!");
+			}
+			return names_.emplace_back(internal::AtomTable::instance().intern(in_.read_string()));
+		}
+
+		BinaryReader& in_;
+		std::pmr::memory_resource* resource_;
+		std::vector<TypeEntry> types_;
+		std::vector<AtomId> names_;
+		std::string scratch_;// setObjectName需要以0结尾的字符串
+	};
+
+	// 可以直接映射到内存使用的对象树快照，启动时不需要把整棵树读出来。
+	// 节点按深度优先顺序存成定长记录，子树是连续的一段；反射字段沿用encode_binary的编码，定长字段在开头的固定偏移上，
+	// 用SnapshotNode不创建对象就能原地读出。另有名字到节点列表的哈希表，按名字查找子树不需要遍历。
+	// materialize只创建根对象，其余对象在findChild/findChildRecursively/forEachChild第一次访问到时才创建
+	// (连接信号前总要先找到对象)，开销只和访问到的节点数有关：findChild创建这一层的所有子对象，
+	// findChildRecursively创建从当前对象到找到的对象路径上每一层的子对象。
+	// 还有没创建的对象的子树调用setParent移动时，先创建整个子树
+	class SnapshotNode;
+
+	class QObjectSnapshot : public std::enable_shared_from_this<QObjectSnapshot> {
+	public:
+		static constexpr uint32_t kMagic = 0x4e535153;// "SQSN"
+		static constexpr uint32_t kVersion = 1;
+
+		// 把对象树写成快照，对类型和动态属性的要求和ObjectWriter一样，不支持时抛出std::runtime_error
+		static void write(BinaryWriter& out, const QObject& root);
+
+		// 只读映射快照文件，映射由返回的快照持有。打不开或者不是快照时抛出std::runtime_error
+		static std::shared_ptr<const QObjectSnapshot> open(const char* path);
+		// 使用一段内存里的快照，不拷贝数据；owner在快照析构前保持数据有效
+		static std::shared_ptr<const QObjectSnapshot> from_memory(const void* data, size_t size, std::shared_ptr<const void> owner = nullptr) {
+			return std::shared_ptr<const QObjectSnapshot>(new QObjectSnapshot(static_cast<const char*>(data), size, std::move(owner)));
+		}
+		static std::shared_ptr<const QObjectSnapshot> from_buffer(std::string data) {
+			auto buffer = std::make_shared<const std::string>(std::move(data));
+			return from_memory(buffer->data(), buffer->size(), buffer);
+		}
+
+		size_t node_count() const { return node_count_; }
+		SnapshotNode root() const;
+
+		// 创建根对象，子对象在第一次访问时才创建。对象可以从指定的memory_resource(比如对象池)分配；
+		// 每次调用得到一棵独立的对象树，对象树持有快照
+		std::shared_ptr<QObject> materialize(std::pmr::memory_resource* resource = nullptr) const;
+
+	private:
+		friend class SnapshotNode;
+		friend class QObject;
+		friend struct internal::SnapshotTree;
+
+		// 所有数值都是小端的uint32_t，偏移相对于快照开头。
+		// 头部依次是：魔数、版本、节点数、类型数、类型表、节点表、名字表的偏移、名字表的桶数、快照总大小
+		static constexpr size_t kHeaderSize = 36;
+		static constexpr size_t kTypeSize = 12;// 类型名的偏移和长度、字段结构的哈希
+		static constexpr size_t kNodeSize = 32;// 见Node
+		static constexpr size_t kBucketSize = 20;// 名字的哈希、偏移和长度，节点列表的偏移和个数
+		static constexpr uint32_t kNoNode = static_cast<uint32_t>(-1);
+
+		struct Node {
+			uint32_t type;
+			uint32_t parent;
+			uint32_t subtree_size;// 包含自己，子树是[节点, 节点+subtree_size)
+			uint32_t child_count;
+			uint32_t name_offset;// 对象名以0结尾
+			uint32_t name_length;
+			uint32_t payload_offset;// 反射字段(encode_binary)和动态属性
+			uint32_t payload_size;
+		};
+		struct Type {
+			TypeId id;
+			const TypeInfo* info;
+		};
+
+		QObjectSnapshot(const char* data, size_t size, std::shared_ptr<const void> owner)
+			: data_(data), size_(size), owner_(std::move(owner)) {
+			if (size_ < kHeaderSize || load(0) != kMagic || load(4) != kVersion || load(32) != size_) {
+				throw std::runtime_error("binary data is not an object snapshot!");
+			}
+			node_count_ = load(8);
+			const uint32_t type_count = load(12);
+			const uint32_t types_offset = load(16);
+			nodes_offset_ = load(20);
+			buckets_offset_ = load(24);
+			bucket_count_ = load(28);
+			check_range(types_offset, type_count, kTypeSize);
+			check_range(nodes_offset_, node_count_, kNodeSize);
+			check_range(buckets_offset_, bucket_count_, kBucketSize);
+			if (node_count_ == 0 || (bucket_count_ & (bucket_count_ - 1)) != 0) {
+				throw std::runtime_error("snapshot data is corrupted!");
+			}
+			// 类型在打开时就解析并校验字段结构，节点只在访问时检查
+			auto& registry = internal::TypeRegistry::instance();
+			types_.reserve(type_count);
+			for (uint32_t i = 0; i < type_count; ++i) {
+				const size_t offset = types_offset + size_t(i) * kTypeSize;
+				const TypeId id = registry.resolve(string(load(offset), load(offset + 4)));
+				const TypeInfo* info = registry.type_info(id);
+				if (!info || !info->decode) {
+					throw std::runtime_error("type in binary data is not registered!");
+				}
+				if (info->schema_hash != load(offset + 8)) {
+					throw std::runtime_error("type in binary data has different fields!");
+				}
+				types_.push_back(Type{ id, info });
+			}
+		}
+
+		uint32_t load(size_t offset) const {
+			return internal::__load_le<uint32_t>(data_ + offset);
+		}
+		void check_range(size_t offset, size_t count, size_t element_size) const {
+			if (offset > size_ || count > (size_ - offset) / element_size) {
+				throw std::runtime_error("snapshot data is corrupted!");
+			}
+		}
+		// 快照里的字符串都以0结尾
+		std::string_view string(uint32_t offset, uint32_t length) const {
+			if (offset >= size_ || length >= size_ - offset || data_[size_t(offset) + length] != '\0') {
+				throw std::runtime_error("snapshot data is corrupted!");
+			}
+			return std::string_view(data_ + offset, length);
+		}
+		Node node(uint32_t index) const {
+			if (index >= node_count_) {
+				throw std::runtime_error("snapshot has a bad node reference!");
+			}
+			const size_t offset = nodes_offset_ + size_t(index) * kNodeSize;
+			const Node node{ load(offset), load(offset + 4), load(offset + 8), load(offset + 12),
+				load(offset + 16), load(offset + 20), load(offset + 24), load(offset + 28) };
+			if (node.type >= types_.size() || node.subtree_size == 0 || node.subtree_size > node_count_ - index ||
+				node.payload_offset > size_ || node.payload_size > size_ - node.payload_offset) {
+				throw std::runtime_error("snapshot data is corrupted!");
+			}
+			return node;
+		}
+
+		// 按深度优先顺序遍历[first, last)里名字为name的节点，func返回true时停止
+		template <typename Func>
+		void for_each_named(const char* name, uint32_t first, uint32_t last, Func&& func) const {
+			if (bucket_count_ == 0 || !*name) {
+				return;
+			}
+			const uint32_t hash = internal::__hash_name(name);
+			const uint32_t mask = bucket_count_ - 1;
+			for (uint32_t pos = hash & mask, probes = 0; probes < bucket_count_; pos = (pos + 1) & mask, ++probes) {
+				const size_t bucket = buckets_offset_ + size_t(pos) * kBucketSize;
+				const uint32_t count = load(bucket + 16);
+				if (count == 0) {
+					return;
+				}
+				if (load(bucket) != hash || string(load(bucket + 4), load(bucket + 8)) != name) {
+					continue;
+				}
+				const uint32_t list = load(bucket + 12);
+				check_range(list, count, sizeof(uint32_t));
+				uint32_t low = 0, high = count;
+				while (low < high) {
+					const uint32_t middle = low + (high - low) / 2;
+					if (load(list + size_t(middle) * sizeof(uint32_t)) < first) {
+						low = middle + 1;
+					}
+					else {
+						high = middle;
+					}
+				}
+				for (; low < count; ++low) {
+					const uint32_t index = load(list + size_t(low) * sizeof(uint32_t));
+					if (index >= last || func(index)) {
+						return;
+					}
+				}
+				return;
+			}
+		}
+
+		const char* data_;
+		size_t size_;
+		std::shared_ptr<const void> owner_;
+		uint32_t node_count_ = 0;
+		uint32_t nodes_offset_ = 0;
+		uint32_t buckets_offset_ = 0;
+		uint32_t bucket_count_ = 0;
+		std::vector<Type> types_;
+	};
+
+	// 快照里的一个节点，不创建对象直接读取；快照析构后不能再使用。
+	// 反射字段里的定长字段(算术类型和枚举)从快照数据里原地读出，见PropertyInfo::load
+	class SnapshotNode {
+	public:
+		SnapshotNode() = default;
+
+		explicit operator bool() const { return snapshot_ != nullptr; }
+		uint32_t index() const { return index_; }
+
+		const TypeInfo& meta() const {
+			return *snapshot_->types_[snapshot_->node(index_).type].info;
+		}
+		std::string_view get_type_name() const { return meta().name; }
+		std::string_view getObjectName() const {
+			const QObjectSnapshot::Node node = snapshot_->node(index_);
+			return snapshot_->string(node.name_offset, node.name_length);
+		}
+
+		size_t childCount() const {
+			return snapshot_->node(index_).child_count;
+		}
+		// 按加入的顺序遍历直接子节点
+		template <typename Func>
+		void forEachChild(Func&& func) const {
+			const uint32_t last = index_ + snapshot_->node(index_).subtree_size;
+			for (uint32_t child = index_ + 1; child < last;) {
+				const uint32_t next = child + snapshot_->node(child).subtree_size;
+				if (next > last) {
+					throw std::runtime_error("snapshot data is corrupted!");
+				}
+				func(SnapshotNode(snapshot_, child));
+				child = next;
+			}
+		}
+		// 没找到时返回空节点
+		SnapshotNode findChild(const char* name) const {
+			SnapshotNode found;
+			if (*name) {
+				forEachChild([&](SnapshotNode child) {
+					if (!found && child.getObjectName() == name) {
+						found = child;
+					}
+					});
+			}
+			return found;
+		}
+		SnapshotNode findChildRecursively(const char* name) const {
+			SnapshotNode found;
+			snapshot_->for_each_named(name, index_ + 1, index_ + snapshot_->node(index_).subtree_size, [&](uint32_t index) {
+				found = SnapshotNode(snapshot_, index);
+				return true;
+				});
+			return found;
+		}
+
+		// 只支持定长字段，其他字段或者字段不存在时返回空的std::any
+		std::any get_field_value_by_name(const char* name) const {
+			const QObjectSnapshot::Node node = snapshot_->node(index_);
+			const TypeInfo& info = *snapshot_->types_[node.type].info;
+			return load_field(node, info, info.property_index.find(name));
+		}
+		std::any get_field_value_by_index(size_t index) const {
+			const QObjectSnapshot::Node node = snapshot_->node(index_);
+			return load_field(node, *snapshot_->types_[node.type].info, index);
+		}
+
+	private:
+		friend class QObjectSnapshot;
+		SnapshotNode(const QObjectSnapshot* snapshot, uint32_t index) : snapshot_(snapshot), index_(index) {}
+
+		std::any load_field(const QObjectSnapshot::Node& node, const TypeInfo& info, size_t index) const {
+			if (index >= info.property_count || !info.properties[index].load) {
+				return std::any();
+			}
+			const PropertyInfo& property = info.properties[index];
+			if (size_t(property.binary_offset) + property.binary_size > node.payload_size) {
+				throw std::runtime_error("snapshot data is corrupted!");
+			}
+			return property.load(snapshot_->data_ + node.payload_offset + property.binary_offset);
+		}
+
+		const QObjectSnapshot* snapshot_ = nullptr;
+		uint32_t index_ = 0;
+	};
+
+	inline SnapshotNode QObjectSnapshot::root() const {
+		return SnapshotNode(this, 0);
+	}
+
+	namespace internal {
+		// 一次materialize得到的对象树共享的状态
+		struct SnapshotTree : std::enable_shared_from_this<SnapshotTree> {
+			std::shared_ptr<const QObjectSnapshot> snapshot;
+			std::pmr::memory_resource* resource = nullptr;
+			// 已经创建的节点。对象析构后记录不删除：只会取用还没创建的节点的祖先，它们一定还在树上
+			std::unordered_map<uint32_t, QObject*> live;
+			std::vector<bool> checked;// 每个类型第一次创建出对象后确认它是QObject，之后直接转换
+
+			std::shared_ptr<QObject> create(uint32_t index) {
+				const QObjectSnapshot::Node node = snapshot->node(index);
+				const QObjectSnapshot::Type& type = snapshot->types_[node.type];
+				std::shared_ptr<IReflectable> created = TypeRegistry::instance().create(type.id, resource);
+				QObject* object = nullptr;
+				if (checked[node.type]) {
+					object = static_cast<QObject*>(static_cast<CObject*>(created.get()));
+				}
+				else if ((object = dynamic_cast<QObject*>(created.get())) == nullptr) {
+					throw std::runtime_error("type is not a QObject!");
+				}
+				checked[node.type] = true;
+				BinaryReader in(snapshot->data_ + node.payload_offset, node.payload_size);
+				type.info->decode(*object, in);
+				if (node.name_length) {
+					object->setObjectName(snapshot->string(node.name_offset, node.name_length).data());
+				}
+				for (size_t count = in.read_count(2); count > 0; --count) {
+					const AtomId id = AtomTable::instance().intern(in.read_string());
+					ObjectReader::read_value(in, *object, id);
+				}
+				if (node.child_count) {
+					object->snapshot_.reset(new SnapshotLink{ shared_from_this(), index, false });
+				}
+				live.emplace(index, object);
+				return std::shared_ptr<QObject>(std::move(created), object);
+			}
+
+			void load_children(QObject& parent, uint32_t index) {
+				const uint32_t last = index + snapshot->node(index).subtree_size;
+				for (uint32_t child = index + 1; child < last;) {
+					const uint32_t next = child + snapshot->node(child).subtree_size;
+					if (next > last) {
+						throw std::runtime_error("snapshot data is corrupted!");
+					}
+					parent.attach_child(create(child));
+					child = next;
+				}
+			}
+
+			// 从最近的已经创建的祖先开始，逐层创建子对象直到index
+			void load_path(uint32_t index) {
+				std::vector<uint32_t> path;
+				auto it = live.find(index);
+				for (; it == live.end(); it = live.find(index)) {
+					if (path.size() >= snapshot->node_count()) {
+						throw std::runtime_error("snapshot data is corrupted!");
+					}
+					path.push_back(index);
+					index = snapshot->node(index).parent;
+				}
+				QObject* object = it->second;
+				for (auto step = path.rbegin(); step != path.rend(); ++step) {
+					if (!object->snapshot_) {
+						throw std::runtime_error("snapshot data is corrupted!");
+					}
+					object->load_snapshot_children();
+					auto child = live.find(*step);
+					if (child == live.end()) {
+						throw std::runtime_error("snapshot data is corrupted!");
+					}
+					object = child->second;
+				}
+			}
+		};
+	}
+
+	inline std::shared_ptr<QObject> QObjectSnapshot::materialize(std::pmr::memory_resource* resource) const {
+		auto tree = std::make_shared<internal::SnapshotTree>();
+		tree->snapshot = shared_from_this();
+		tree->resource = resource;
+		tree->checked.assign(types_.size(), false);
+		return tree->create(0);
+	}
+
+	inline void QObjectSnapshot::write(BinaryWriter& out, const QObject& root) {
+		// 按深度优先顺序展开对象树，还没创建的子对象先创建出来
+		std::vector<const QObject*> objects;
+		std::vector<uint32_t> parents;
+		std::vector<std::pair<const QObject*, uint32_t>> stack{ { &root, kNoNode } };
+		while (!stack.empty()) {
+			auto [object, parent] = stack.back();
+			stack.pop_back();
+			if (object->snapshot_) {
+				const_cast<QObject*>(object)->load_snapshot_children();
+			}
+			const uint32_t index = static_cast<uint32_t>(objects.size());
+			objects.push_back(object);
+			parents.push_back(parent);
+			for (auto it = object->children_.rbegin(); it != object->children_.rend(); ++it) {
+				if (*it) {
+					stack.emplace_back(it->get(), index);
+				}
+			}
+		}
+		const size_t count = objects.size();
+		std::vector<uint32_t> subtree_sizes(count, 1);
+		std::vector<uint32_t> child_counts(count, 0);
+		for (size_t i = count - 1; i > 0; --i) {
+			subtree_sizes[parents[i]] += subtree_sizes[i];
+			++child_counts[parents[i]];
+		}
+
+		// 字符串和节点数据放在最后，先写到单独的缓冲区里
+		BinaryWriter blob;
+		auto add_string = [&](std::string_view text) {
+			const size_t offset = blob.size();
+			blob.write_bytes(text.data(), text.size());
+			blob.write(uint8_t(0));
+			return offset;
+		};
+		std::unordered_map<const TypeInfo*, uint32_t> type_refs;
+		std::vector<const TypeInfo*> types;
+		std::vector<size_t> type_names;
+		std::vector<std::array<size_t, 5>> nodes(count);// 类型、名字偏移、名字长度、数据偏移、数据大小
+		std::unordered_map<AtomId, std::vector<uint32_t>> named;
+		std::vector<AtomId> name_order;// 名字表按第一次出现的顺序填写，结果和哈希表的遍历顺序无关
+		for (size_t i = 0; i < count; ++i) {
+			const QObject& object = *objects[i];
+			const TypeInfo& info = object.meta();
+			if (!info.encode) {
+				throw std::runtime_error("type is not binary serializable!");
+			}
+			auto [type, inserted] = type_refs.try_emplace(&info, static_cast<uint32_t>(types.size()));
+			if (inserted) {
+				types.push_back(&info);
+				type_names.push_back(add_string(info.name));
+			}
+			const size_t name_offset = add_string(object.objectName_);
+			const size_t payload_offset = blob.size();
+			info.encode(object, blob);
+			blob.write_varint(object.dynamicProperties_.size());
+			for (const auto& property : object.dynamicProperties_) {
+				blob.write_string(property.name);
+				ObjectWriter::write_value(blob, property.value);
+			}
+			nodes[i] = { type->second, name_offset, object.objectName_.size(), payload_offset, blob.size() - payload_offset };
+			if (object.nameAtom_ != internal::AtomTable::invalid_atom) {
+				auto& list = named[object.nameAtom_];
+				if (list.empty()) {
+					name_order.push_back(object.nameAtom_);
+				}
+				list.push_back(static_cast<uint32_t>(i));
+			}
+		}
+
+		uint32_t bucket_count = 0;
+		if (!name_order.empty()) {
+			bucket_count = 1;
+			while (bucket_count < name_order.size() * 2) {
+				bucket_count *= 2;
+			}
+		}
+		const size_t types_offset = kHeaderSize;
+		const size_t nodes_offset = types_offset + types.size() * kTypeSize;
+		const size_t buckets_offset = nodes_offset + count * kNodeSize;
+		const size_t lists_offset = buckets_offset + size_t(bucket_count) * kBucketSize;
+		size_t named_count = 0;
+		for (AtomId atom : name_order) {
+			named_count += named[atom].size();
+		}
+		const size_t blob_offset = lists_offset + named_count * sizeof(uint32_t);
+		const size_t total = blob_offset + blob.size();
+		if (total > std::numeric_limits<uint32_t>::max()) {
+			throw std::runtime_error("snapshot is too large!");
+		}
+
+		char* data = out.append(blob_offset);
+		std::memset(data, 0, blob_offset);
+		auto put = [&](size_t offset, size_t value) {
+			internal::__store_le(data + offset, static_cast<uint32_t>(value));
+		};
+		put(0, kMagic);
+		put(4, kVersion);
+		put(8, count);
+		put(12, types.size());
+		put(16, types_offset);
+		put(20, nodes_offset);
+		put(24, buckets_offset);
+		put(28, bucket_count);
+		put(32, total);
+		for (size_t i = 0; i < types.size(); ++i) {
+			put(types_offset + i * kTypeSize, blob_offset + type_names[i]);
+			put(types_offset + i * kTypeSize + 4, types[i]->name.size());
+			put(types_offset + i * kTypeSize + 8, types[i]->schema_hash);
+		}
+		for (size_t i = 0; i < count; ++i) {
+			const size_t offset = nodes_offset + i * kNodeSize;
+			put(offset, nodes[i][0]);
+			put(offset + 4, parents[i]);
+			put(offset + 8, subtree_sizes[i]);
+			put(offset + 12, child_counts[i]);
+			put(offset + 16, blob_offset + nodes[i][1]);
+			put(offset + 20, nodes[i][2]);
+			put(offset + 24, blob_offset + nodes[i][3]);
+			put(offset + 28, nodes[i][4]);
+		}
+		size_t list_offset = lists_offset;
+		for (AtomId atom : name_order) {
+			const auto& list = named[atom];
+			const QObject& first = *objects[list.front()];
+			const uint32_t hash = internal::__hash_name(first.objectName_.c_str());
+			uint32_t pos = hash & (bucket_count - 1);
+			while (internal::__load_le<uint32_t>(data + buckets_offset + size_t(pos) * kBucketSize + 16) != 0) {
+				pos = (pos + 1) & (bucket_count - 1);
+			}
+			const size_t bucket = buckets_offset + size_t(pos) * kBucketSize;
+			put(bucket, hash);
+			put(bucket + 4, blob_offset + nodes[list.front()][1]);
+			put(bucket + 8, first.objectName_.size());
+			put(bucket + 12, list_offset);
+			put(bucket + 16, list.size());
+			for (uint32_t index : list) {
+				put(list_offset, index);
+				list_offset += sizeof(uint32_t);
+			}
+		}
+		out.write_bytes(blob.data(), blob.size());
+	}
+
+	inline void QObject::load_snapshot_children() {
+		if (!snapshot_->childrenLoaded) {
+			snapshot_->childrenLoaded = true;
+			snapshot_->tree->load_children(*this, snapshot_->node);
+		}
+	}
+
+	// 已经创建的对象都在名字索引里；还没创建的同名对象按深度优先顺序排列，只需要创建第一个
+	inline void QObject::load_snapshot_match(const char* name) {
+		internal::SnapshotTree& tree = *snapshot_->tree;
+		const uint32_t node = snapshot_->node;
+		const uint32_t last = node + tree.snapshot->node(node).subtree_size;
+		tree.snapshot->for_each_named(name, node + 1, last, [&](uint32_t index) {
+			if (tree.live.count(index)) {
+				return false;
+			}
+			tree.load_path(index);
+			return true;
+			});
+	}
+
+	inline void QObject::load_snapshot_subtree() {
+		load_snapshot_children();
+		snapshot_.reset();
+		for (auto& child : children_) {
+			if (child && child->snapshot_) {
+				child->load_snapshot_subtree();
+			}
+		}
+	}
+
+}// namespace refl
+
+
+namespace base {
+
+	// 分层时间轮：插入、删除、到期都是O(1)，精度为一个tick。适合大量的粗精度定时器，比如连接空闲超时。
+	// 时间轮只管理id和到期tick，id对应的任务由使用者保存。
+	class CTimerWheel {
+	public:
+		static constexpr uint32_t kNil = 0xffffffffu;
+		static constexpr int kLevelBits = 6;
+		static constexpr uint32_t kSlots = 1u << kLevelBits;
+		static constexpr int kLevels = 4;// 共可以表示2^24个tick，更远的定时器在最高层反复下沉
+
+		CTimerWheel() {
+			for (auto& level : heads_) {
+				std::fill(std::begin(level), std::end(level), kNil);
+			}
+		}
+
+		bool empty() const { return count_ == 0; }
+		size_t size() const { return count_; }
+		uint64_t currentTick() const { return currentTick_; }
+
+		bool contains(uint32_t id) const {
+			return id < links_.size() && links_[id].linked;
+		}
+
+		// 已经过期的tick按下一个tick处理
+		void insert(uint32_t id, uint64_t expireTick) {
+			if (id >= links_.size()) {
+				links_.resize(static_cast<size_t>(id) + 1);
+			}
+			assert(!links_[id].linked);
+			links_[id].expire = std::max(expireTick, currentTick_ + 1);
+			place(id);
+			++count_;
+		}
+
+		void remove(uint32_t id) {
+			if (contains(id)) {
+				unlink(id);
+				--count_;
+			}
+		}
+
+		// 推进到toTick，到期的id按到期顺序追加到expired。中间没有到期也没有下沉的tick直接跳过
+		void advance(uint64_t toTick, std::vector<uint32_t>& expired) {
+			uint64_t next = 0;
+			while (currentTick_ < toTick) {
+				if (!nextTick(next) || next > toTick) {
+					currentTick_ = toTick;
+					break;
+				}
+				currentTick_ = next;
+				// 走完一圈时把上一层对应槽里的定时器下沉，下沉后可能正好落在当前tick，所以先下沉再处理到期
+				uint64_t tick = currentTick_;
+				for (int level = 1; level < kLevels && (tick & (kSlots - 1)) == 0; ++level) {
+					tick >>= kLevelBits;
+					cascade(level, static_cast<uint32_t>(tick & (kSlots - 1)));
+				}
+				uint32_t& head = heads_[0][currentTick_ & (kSlots - 1)];
+				while (head != kNil) {
+					const uint32_t id = head;
+					unlink(id);
+					--count_;
+					expired.push_back(id);
+				}
+			}
+		}
+
+		// 下一次需要推进的tick：最近的到期tick，或者更高层槽的下沉时刻。空的时候返回false
+		bool nextTick(uint64_t& tick) const {
+			if (count_ == 0) {
+				return false;
+			}
+			uint64_t best = UINT64_MAX;
+			for (int level = 0; level < kLevels; ++level) {
+				if (occupied_[level] == 0) {
+					continue;
+				}
+				const int shift = level * kLevelBits;
+				const uint64_t base = currentTick_ >> shift;
+				const uint32_t current = static_cast<uint32_t>(base & (kSlots - 1));
+				// 从current的下一个槽开始循环找第一个非空槽
+				const uint64_t rotated = (occupied_[level] >> ((current + 1) & (kSlots - 1))) |
+					(occupied_[level] << ((kSlots - ((current + 1) & (kSlots - 1))) & (kSlots - 1)));
+				const uint64_t distance = static_cast<uint64_t>(countTrailingZeros(rotated)) + 1;
+				best = std::min(best, (base + distance) << shift);
+			}
+			tick = best;
+			return true;
+		}
+
+	private:
+		struct Link {
+			uint32_t prev = kNil;
+			uint32_t next = kNil;
+			uint64_t expire = 0;
+			uint8_t level = 0;
+			uint8_t slot = 0;
+			bool linked = false;
+		};
+
+		static int countTrailingZeros(uint64_t value) {
+			int count = 0;
+			while ((value & 1) == 0) {
+				value >>= 1;
+				++count;
+			}
+			return count;
+		}
+
+		void place(uint32_t id) {
+			Link& link = links_[id];
+			const uint64_t delta = link.expire > currentTick_ ? link.expire - currentTick_ : 0;
+			int level = 0;
+			while (level < kLevels - 1 && delta >= (uint64_t(1) << ((level + 1) * kLevelBits))) {
+				++level;
+			}
+			uint64_t expire = link.expire;
+			if (delta >= (uint64_t(1) << (kLevels * kLevelBits))) {// 超出范围，先放到最高层最远的槽，下沉时再重新放置
+				expire = currentTick_ + (uint64_t(1) << (kLevels * kLevelBits)) - 1;
+			}
+			const uint32_t slot = static_cast<uint32_t>((expire >> (level * kLevelBits)) & (kSlots - 1));
+			link.level = static_cast<uint8_t>(level);
+			link.slot = static_cast<uint8_t>(slot);
+			link.prev = kNil;
+			link.next = heads_[level][slot];
+			if (link.next != kNil) {
+				links_[link.next].prev = id;
+			}
+			heads_[level][slot] = id;
+			occupied_[level] |= uint64_t(1) << slot;
+			link.linked = true;
+		}
+
+		void unlink(uint32_t id) {
+			Link& link = links_[id];
+			if (link.prev != kNil) {
+				links_[link.prev].next = link.next;
+			}
+			else {
+				heads_[link.level][link.slot] = link.next;
+				if (link.next == kNil) {
+					occupied_[link.level] &= ~(uint64_t(1) << link.slot);
+				}
+			}
+			if (link.next != kNil) {
+				links_[link.next].prev = link.prev;
+			}
+			link.prev = link.next = kNil;
+			link.linked = false;
+		}
+
+		void cascade(int level, uint32_t slot) {
+			uint32_t id = heads_[level][slot];
+			heads_[level][slot] = kNil;
+			occupied_[level] &= ~(uint64_t(1) << slot);
+			while (id != kNil) {
+				const uint32_t next = links_[id].next;
+				links_[id].linked = false;
+				place(id);
+				id = next;
+			}
+		}
+
+		uint32_t heads_[kLevels][kSlots] = {};
+		uint64_t occupied_[kLevels] = {};
+		std::vector<Link> links_;
+		uint64_t currentTick_ = 0;
+		size_t count_ = 0;
+	};
+
+	// CEventLoop提供事件循环功能支持
+	class CEventLoop {
+	public:
+		using Clock = std::chrono::steady_clock;
+		using TimePoint = Clock::time_point;
+		using Duration = Clock::duration;
+		using Handler = CTask;
+
+		// 精确定时器放在最小堆里，按时间点触发；粗精度定时器放在时间轮里，按tick触发，不会早于到期时间，最多晚一个tick
+		enum class TimerType {
+			PreciseTimer,
+			CoarseTimer
+		};
+
+		// postCancellable和startTimer返回的句柄，generation用来识别已经释放又被复用的任务节点
+		struct CancelHandle {
+			uint32_t index = UINT32_MAX;
+			uint32_t generation = 0;
+			explicit operator bool() const { return index != UINT32_MAX; }
+		};
+
+		struct TaskEventInfo {
+			TimePoint time;
+			Handler handler;
+			Duration interval{};
+			bool repeat = false;
+		};
+		class IEventLoopHost {
+		public:
+			CEventLoop* eventLoop = nullptr;
+			virtual ~IEventLoopHost() = default;
+			virtual void onPostTask() = 0;
+			virtual void onWaitForTask(std::condition_variable& cond, std::unique_lock<std::mutex>& locker) = 0;
+			virtual void onEvent(TaskEventInfo& event) = 0;
+			virtual void onWaitForRun(std::condition_variable& cond, std::unique_lock<std::mutex>& locker, const TimePoint& timePoint) = 0;
+			// 不等待，处理已经就绪的外部事件。任务太多、事件循环没有机会等待时每轮调用一次
+			virtual void onProcessEvents() {}
+		};
+	private:
+		static constexpr uint32_t kNotInHeap = UINT32_MAX;
+
+		// 所有任务的节点，按下标复用，堆和时间轮里只保存下标
+		struct TaskNode {
+			TimePoint time;
+			Handler handler;
+			Duration interval{};
+			uint32_t generation = 1;
+			bool repeat = false;
+			bool coarse = false;
+			bool inUse = false;
+		};
+		struct HeapEntry {
+			TimePoint time;
+			uint64_t sequence;// 同一时间点的任务按投递顺序执行
+			uint32_t index;
+			bool before(const HeapEntry& other) const {
+				return time != other.time ? time < other.time : sequence < other.sequence;
+			}
+		};
+		// 一批到期的任务，在一次加锁里取出，解锁后依次执行
+		struct ReadyTask {
+			uint32_t index = 0;
+			uint32_t generation = 0;
+			TaskEventInfo event;
+			bool cancelled = false;
+		};
+		// 立即执行的任务走无锁的多生产者单消费者队列（Vyukov的侵入式队列），不需要加mutex_
+		// 节点执行完后由事件循环线程放回recycled_，生产者整串取走放到线程本地的缓存里复用，稳定运行时post不分配内存。
+		// 生产者只用exchange整串取走，不会遇到ABA；事件循环线程是唯一往recycled_里放的线程
+		struct PostedTask {
+			std::atomic<PostedTask*> next{ nullptr };
+			Handler handler;
+		};
+		struct PostedTaskCache {
+			PostedTask* head = nullptr;
+			~PostedTaskCache() {
+				deletePostedList(head);
+			}
+		};
+		struct PostedTaskRecycler {
+			CEventLoop* loop;
+			void operator()(PostedTask* task) const {
+				loop->recyclePosted(task);
+			}
+		};
+		static constexpr size_t kMaxPostedBatch = 1024;// 每轮最多执行的立即任务数，避免持续的post饿死定时器
+
+		IEventLoopHost* host = nullptr;
+		std::vector<TaskNode> nodes_;
+		std::vector<uint32_t> freeNodes_;
+		std::vector<HeapEntry> heap_;// 精确任务的最小堆
+		std::vector<uint32_t> heapPos_;// 每个节点在heap_中的位置，取消时O(log n)删除。和nodes_分开存放，调整堆时访问的内存更少
+		uint64_t sequence_ = 0;
+		CTimerWheel wheel_;
+		TimePoint wheelStart_ = Clock::now();
+		Duration wheelResolution_ = std::chrono::milliseconds(1);
+		std::vector<uint32_t> expired_;
+		std::mutex mutex_;
+		std::condition_variable cond_;
+		std::atomic<bool> running_{ true };
+		std::atomic<bool> sleeping_{ false };// 事件循环正在等待，只有这时投递任务才需要唤醒它
+		std::atomic<uint64_t> cancelEpoch_{ 0 };// 每次取消加一，执行一批任务时据此判断是否需要重新检查
+		Duration timeSlice_ = Duration::zero();// 每轮执行立即任务的时间预算，0表示不限制，只在事件循环线程读取
+		TimePoint waitDeadline_ = TimePoint::max();// 正在等待的时间点，由mutex_保护
+
+		PostedTask postedStub_;
+		std::atomic<PostedTask*> postedTail_{ &postedStub_ };// 生产者交换尾指针
+		PostedTask* postedHead_ = &postedStub_;// 只有事件循环线程访问
+		std::atomic<PostedTask*> recycled_{ nullptr };// 执行完的节点
+
+		// postBatched合并投递的任务，和定时任务分开加锁，追加时不需要唤醒事件循环
+		std::mutex batched_mutex_;
+		std::vector<Handler> batched_;
+
+		static thread_local CEventLoop* s_currentThreadEventLoop;
+		static thread_local PostedTaskCache s_postedTaskCache;
+
+		void runBatched() {
+			std::vector<Handler> batch;
+			{
+				std::lock_guard<std::mutex> lock(batched_mutex_);
+				batch.swap(batched_);
+			}
+			for (auto& handler : batch) {
+				handler();
+			}
+		}
+	public:
+		CEventLoop(IEventLoopHost* host = nullptr) {
+			this->host = host;
+			if (host) {
+				host->eventLoop = this;
+			}
+			if (s_currentThreadEventLoop == nullptr) {
+				s_currentThreadEventLoop = this;
+			}
+		}
+		~CEventLoop() {
+			while (PostedTask* task = popPosted()) {
+				delete task;
+			}
+			deletePostedList(recycled_.exchange(nullptr));
+			if (s_currentThreadEventLoop == this) {
+				s_currentThreadEventLoop = nullptr;
+			}
+		}
+
+		// 当前线程的事件循环：正在run的事件循环，或者在当前线程上构造的第一个事件循环
+		static CEventLoop* currentThreadEventLoop() {
+			return s_currentThreadEventLoop;
+		}
+
+		// 每轮事件循环执行立即任务的时间预算，用完后先处理到期的定时器和宿主的消息，0表示不限制（每轮最多kMaxPostedBatch个）。
+		// 在run之前或者在事件循环线程中设置
+		void setTimeSlice(Duration budget) {
+			timeSlice_ = budget;
+		}
+
+		// 设置时间轮的tick精度，默认1毫秒。只在没有粗精度定时器时生效
+		bool setCoarseTimerResolution(Duration resolution) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (!wheel_.empty() || resolution <= Duration::zero()) {
+				return false;
+			}
+			wheel_ = CTimerWheel();
+			wheelStart_ = Clock::now();
+			wheelResolution_ = resolution;
+			return true;
+		}
+
+		// 合并投递：上一批还没执行时追加的handler不会再次唤醒事件循环，整批在一个任务里按顺序执行
+		void postBatched(Handler handler) {
+			bool first;
+			{
+				std::lock_guard<std::mutex> lock(batched_mutex_);
+				first = batched_.empty();
+				batched_.push_back(std::move(handler));
+			}
+			if (first) {
+				post([this] { runBatched(); });
+			}
+		}
+
+		void post(Handler handler, Duration delay = Duration::zero()) {
+			if (delay > Duration::zero()) {
+				addTask(std::move(handler), delay, Duration::zero(), false, false);
+				return;
+			}
+			PostedTask* task = acquirePosted();
+			task->handler = std::move(handler);
+			PostedTask* previous = postedTail_.exchange(task);
+			previous->next.store(task, std::memory_order_release);
+			// 和runLoop里先设置sleeping_再检查队列配对：要么这里看到sleeping_，要么事件循环看到新任务
+			if (sleeping_.load()) {
+				std::lock_guard<std::mutex> lock(mutex_);
+				wakeUp();
+			}
+		}
+
+		//可以取消的post
+		CancelHandle postCancellable(Handler handler, Duration delay = Duration::zero(), TimerType type = TimerType::PreciseTimer) {
+			return addTask(std::move(handler), delay, Duration::zero(), false, type == TimerType::CoarseTimer);
+		}
+
+		// 停止一个周期性的定时器
+		void cancelPostTask(CancelHandle& handle) {
+			cancel(handle);
+		}
+
+		// 启动一个周期性的定时器
+		CancelHandle startTimer(Handler handler, Duration interval, TimerType type = TimerType::PreciseTimer) {
+			return addTask(std::move(handler), interval, interval, true, type == TimerType::CoarseTimer);
+		}
+
+		// 停止一个周期性的定时器
+		void stopTimer(CancelHandle& handle) {
+			cancel(handle);
+		}
+
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+		// co_await loop.sleep(d)在d之后、co_await loop.switch_to()尽快在这个事件循环的线程上恢复协程。
+		// 恢复用的任务只捕获协程句柄，存放在任务内部，不额外分配内存
+		struct ResumeAwaiter {
+			CEventLoop* loop;
+			Duration delay;
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) {
+				loop->post([handle] { handle.resume(); }, delay);
+			}
+			void await_resume() const noexcept {}
+		};
+		ResumeAwaiter sleep(Duration delay) {
+			return { this, delay };
+		}
+		ResumeAwaiter switch_to() {
+			return { this, Duration::zero() };
+		}
+#endif
+
+		void run() {
+			CEventLoop* previous = s_currentThreadEventLoop;
+			s_currentThreadEventLoop = this;// run期间当前线程的事件循环就是自己
+			runLoop();
+			s_currentThreadEventLoop = previous;
+		}
+
+		void stop() {
+			std::unique_lock<std::mutex> lock(mutex_);
+			running_ = false;
+			cond_.notify_all();
+			if (host) {
+				host->onPostTask();// 唤醒可能阻塞在host里的事件循环
+			}
+		}
+
+	private:
+		CancelHandle addTask(Handler handler, Duration delay, Duration interval, bool repeat, bool coarse) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			uint32_t index;
+			if (!freeNodes_.empty()) {
+				index = freeNodes_.back();
+				freeNodes_.pop_back();
+			}
+			else {
+				index = static_cast<uint32_t>(nodes_.size());
+				nodes_.emplace_back();
+				heapPos_.push_back(kNotInHeap);
+			}
+			TaskNode& node = nodes_[index];
+			node.time = Clock::now() + delay;
+			node.handler = std::move(handler);
+			node.interval = interval;
+			node.repeat = repeat;
+			node.coarse = coarse;
+			node.inUse = true;
+			schedule(index);
+			if (sleeping_.load() && nextDeadline() < waitDeadline_) {// 新任务比事件循环正在等待的时间点更早
+				wakeUp();
+			}
+			return { index, node.generation };
+		}
+
+		// 调用时持有mutex_
+		void wakeUp() {
+			cond_.notify_one();
+			if (host) {
+				host->onPostTask();
+			}
+		}
+
+		PostedTask* acquirePosted() {
+			PostedTask*& cache = s_postedTaskCache.head;
+			if (cache == nullptr) {
+				cache = recycled_.exchange(nullptr, std::memory_order_acquire);
+			}
+			if (PostedTask* task = cache) {
+				cache = task->next.load(std::memory_order_relaxed);
+				task->next.store(nullptr, std::memory_order_relaxed);
+				return task;
+			}
+			return new PostedTask;
+		}
+
+		// 只在事件循环线程调用。handler在这里析构，捕获的资源仍然在事件循环线程释放
+		void recyclePosted(PostedTask* task) {
+			task->handler = nullptr;
+			PostedTask* head = recycled_.load(std::memory_order_relaxed);
+			do {
+				task->next.store(head, std::memory_order_relaxed);
+			} while (!recycled_.compare_exchange_weak(head, task, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		static void deletePostedList(PostedTask* task) {
+			while (task) {
+				PostedTask* next = task->next.load(std::memory_order_relaxed);
+				delete task;
+				task = next;
+			}
+		}
+
+		// 只在事件循环线程调用。生产者交换了尾指针但还没有链接next时返回nullptr，hasPosted仍然为true
+		PostedTask* popPosted() {
+			PostedTask* head = postedHead_;
+			PostedTask* next = head->next.load(std::memory_order_acquire);
+			if (head == &postedStub_) {
+				if (next == nullptr) {
+					return nullptr;
+				}
+				postedHead_ = next;
+				head = next;
+				next = next->next.load(std::memory_order_acquire);
+			}
+			if (next) {
+				postedHead_ = next;
+				return head;
+			}
+			if (head != postedTail_.load()) {
+				return nullptr;
+			}
+			postedStub_.next.store(nullptr, std::memory_order_relaxed);
+			PostedTask* previous = postedTail_.exchange(&postedStub_);
+			previous->next.store(&postedStub_, std::memory_order_release);
+			next = head->next.load(std::memory_order_acquire);
+			if (next) {
+				postedHead_ = next;
+				return head;
+			}
+			return nullptr;
+		}
+
+		bool hasPosted() const {
+			return postedHead_ != &postedStub_ || postedTail_.load() != &postedStub_;
+		}
+
+		// 返回队列里是否还有没执行的任务
+		bool runPosted() {
+			const bool budgeted = timeSlice_ > Duration::zero();
+			const TimePoint sliceEnd = budgeted ? Clock::now() + timeSlice_ : TimePoint();
+			for (size_t count = 1; budgeted || count <= kMaxPostedBatch; ++count) {
+				std::unique_ptr<PostedTask, PostedTaskRecycler> task(popPosted(), PostedTaskRecycler{ this });
+				if (!task) {
+					break;
+				}
+				if (host) {
+					TaskEventInfo info{ TimePoint(), std::move(task->handler) };
+					host->onEvent(info);
+				}
+				else {
+					task->handler();
+				}
+				if (budgeted && (count & 63) == 0 && Clock::now() >= sliceEnd) {// 每64个任务看一次时间
+					break;
+				}
+			}
+			return hasPosted();
+		}
+
+		void schedule(uint32_t index) {
+			TaskNode& node = nodes_[index];
+			if (node.coarse) {
+				wheel_.insert(index, toTick(node.time));
+			}
+			else {
+				heap_.push_back({ node.time, sequence_++, index });
+				siftDown(siftUp(heap_.size() - 1));
+			}
+		}
+
+		void setHeapEntry(size_t pos, const HeapEntry& entry) {
+			heap_[pos] = entry;
+			heapPos_[entry.index] = static_cast<uint32_t>(pos);
+		}
+
+		size_t siftUp(size_t pos) {
+			const HeapEntry entry = heap_[pos];
+			while (pos > 0) {
+				const size_t parent = (pos - 1) / 2;
+				if (!entry.before(heap_[parent])) {
+					break;
+				}
+				setHeapEntry(pos, heap_[parent]);
+				pos = parent;
+			}
+			setHeapEntry(pos, entry);
+			return pos;
+		}
+
+		void siftDown(size_t pos) {
+			const HeapEntry entry = heap_[pos];
+			const size_t size = heap_.size();
+			while (true) {
+				size_t child = pos * 2 + 1;
+				if (child >= size) {
+					break;
+				}
+				if (child + 1 < size && heap_[child + 1].before(heap_[child])) {
+					++child;
+				}
+				if (!heap_[child].before(entry)) {
+					break;
+				}
+				setHeapEntry(pos, heap_[child]);
+				pos = child;
+			}
+			setHeapEntry(pos, entry);
+		}
+
+		void removeFromHeap(uint32_t index) {
+			const size_t pos = heapPos_[index];
+			heapPos_[index] = kNotInHeap;
+			const size_t last = heap_.size() - 1;
+			if (pos != last) {
+				setHeapEntry(pos, heap_[last]);
+				heap_.pop_back();
+				siftDown(siftUp(pos));
+			}
+			else {
+				heap_.pop_back();
+			}
+		}
+
+		// 释放节点，返回节点里的handler，由调用者在锁外析构
+		Handler releaseNode(uint32_t index) {
+			TaskNode& node = nodes_[index];
+			Handler handler = std::move(node.handler);
+			node.handler = nullptr;
+			node.inUse = false;
+			if (++node.generation == 0) {
+				node.generation = 1;
+			}
+			freeNodes_.push_back(index);
+			return handler;
+		}
+
+		void cancel(CancelHandle& handle) {
+			if (!handle) {
+				return;
+			}
+			Handler handler;// 在锁外析构，handler捕获的对象析构时可能再调用事件循环
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				if (handle.index < nodes_.size() && nodes_[handle.index].inUse && nodes_[handle.index].generation == handle.generation) {
+					if (nodes_[handle.index].coarse) {
+						wheel_.remove(handle.index);
+					}
+					else if (heapPos_[handle.index] != kNotInHeap) {
+						removeFromHeap(handle.index);
+					}
+					handler = releaseNode(handle.index);
+					cancelEpoch_.fetch_add(1, std::memory_order_release);
+					// 取消的是事件循环正在等待的任务时要唤醒它，让它按新的时间点重新等待，而不是在已经取消的时间点醒来
+					if (sleeping_.load() && nextDeadline() != waitDeadline_) {
+						wakeUp();
+					}
+				}
+			}
+			handle = CancelHandle();
+		}
+
+		// 时间轮的tick向上取整，保证粗精度定时器不会提前触发
+		uint64_t toTick(TimePoint time) const {
+			if (time <= wheelStart_) {
+				return 0;
+			}
+			const auto ticks = (time - wheelStart_ + wheelResolution_ - Duration(1)) / wheelResolution_;
+			return static_cast<uint64_t>(ticks);
+		}
+
+		bool hasTasks() const {
+			return !heap_.empty() || !wheel_.empty();
+		}
+
+		// 下一次需要醒来的时间点
+		TimePoint nextDeadline() const {
+			TimePoint deadline = TimePoint::max();
+			if (!heap_.empty()) {
+				deadline = heap_.front().time;
+			}
+			uint64_t tick;
+			if (wheel_.nextTick(tick)) {
+				deadline = std::min(deadline, wheelStart_ + wheelResolution_ * static_cast<Duration::rep>(tick));
+			}
+			return deadline;
+		}
+
+		// 取出所有到期的任务：先是堆里的精确任务，再是时间轮里的粗精度任务。节点保留到这批执行完
+		void collectReady(TimePoint now, std::vector<ReadyTask>& ready) {
+			auto take = [&](uint32_t index) {
+				TaskNode& node = nodes_[index];
+				ReadyTask& task = ready.emplace_back();
+				task.index = index;
+				task.generation = node.generation;
+				task.event.time = node.time;
+				task.event.handler = std::move(node.handler);
+				task.event.interval = node.interval;
+				task.event.repeat = node.repeat;
+			};
+			while (!heap_.empty() && heap_.front().time <= now) {
+				const uint32_t index = heap_.front().index;
+				removeFromHeap(index);
+				take(index);
+			}
+			if (!wheel_.empty()) {
+				expired_.clear();
+				wheel_.advance(static_cast<uint64_t>((now - wheelStart_) / wheelResolution_), expired_);
+				for (uint32_t index : expired_) {
+					take(index);
+				}
+			}
+		}
+
+		bool isLive(const ReadyTask& ready) const {
+			return nodes_[ready.index].inUse && nodes_[ready.index].generation == ready.generation;
+		}
+
+		// 一次加锁取出所有到期的任务，解锁后依次执行，再加锁一次把周期定时器放回去。
+		// 执行期间有任务被取消时才重新加锁检查剩下的任务
+		void runReady(std::vector<ReadyTask>& batch, std::unique_lock<std::mutex>& lock) {
+			batch.clear();
+			collectReady(Clock::now(), batch);
+			if (batch.empty()) {
+				return;
+			}
+			uint64_t epoch = cancelEpoch_.load(std::memory_order_acquire);
+			lock.unlock();
+			for (size_t i = 0; i < batch.size(); ++i) {
+				const uint64_t current = cancelEpoch_.load(std::memory_order_acquire);
+				if (current != epoch) {
+					epoch = current;
+					lock.lock();
+					for (size_t j = i; j < batch.size(); ++j) {
+						batch[j].cancelled = batch[j].cancelled || !isLive(batch[j]);
+					}
+					lock.unlock();
+				}
+				ReadyTask& ready = batch[i];
+				if (ready.cancelled) {
+					continue;
+				}
+				if (host) {
+					host->onEvent(ready.event);
+				}
+				else {
+					ready.event.handler();
+				}
+				if (!ready.event.repeat) {
+					ready.event.handler = nullptr;// 在锁外析构
+				}
+			}
+
+			lock.lock();
+			const TimePoint now = Clock::now();
+			bool leftover = false;
+			for (auto& ready : batch) {
+				if (ready.cancelled || !isLive(ready)) {// 节点已经在cancel里释放了
+					leftover = leftover || static_cast<bool>(ready.event.handler);
+					continue;
+				}
+				if (ready.event.repeat) { // 是个timer,计算下一次触发时机并放回去
+					TaskNode& node = nodes_[ready.index];
+					node.handler = std::move(ready.event.handler);
+					node.time = now + node.interval;
+					schedule(ready.index);
+				}
+				else {
+					releaseNode(ready.index);
+				}
+			}
+			if (leftover) {// handler里停止了自己的定时器，handler在锁外析构
+				lock.unlock();
+				batch.clear();
+				lock.lock();
+			}
+		}
+
+		void runLoop() {
+			std::vector<ReadyTask> batch;
+			while (running_) {
+				const bool pending = runPosted();
+				std::unique_lock<std::mutex> lock(mutex_);
+				if (hasTasks()) {
+					runReady(batch, lock);
+				}
+				if (!running_) {
+					break;
+				}
+				if (pending || hasPosted()) {
+					if (pending && host) {// 任务还没执行完，不会进入等待，让宿主处理一下自己的消息
+						lock.unlock();
+						host->onProcessEvents();
+					}
+					continue;
+				}
+
+				waitDeadline_ = hasTasks() ? nextDeadline() : TimePoint::max();
+				sleeping_.store(true);
+				// 设置sleeping_之后再检查一次队列，和post里先入队再检查sleeping_配对，不会丢失唤醒
+				if (!hasPosted() && waitDeadline_ > Clock::now()) {
+					if (waitDeadline_ == TimePoint::max()) {
+						if (host) {
+							host->onWaitForTask(cond_, lock);
+						}
+						else {
+							cond_.wait(lock, [this] { return hasTasks() || hasPosted() || !running_; });
+						}
+					}
+					else {
+						if (host) {
+							host->onWaitForRun(cond_, lock, waitDeadline_);
+						}
+						else {
+							cond_.wait_until(lock, waitDeadline_);
+						}
+					}
+				}
+				sleeping_.store(false);
+			}
+		}
+	};
+
+	// CEventLoopPool在N个线程上各运行一个CEventLoop。
+	// post投递的任务不绑定线程，先放进当前工作线程（或者轮流选一个）的队列，空闲的事件循环会从别的队列偷任务；
+	// postTo投递到指定的事件循环或者对象所属的事件循环。任务里启动的定时器属于执行它的那个事件循环
+	class CEventLoopPool {
+	public:
+		using Handler = CEventLoop::Handler;
+		using Duration = CEventLoop::Duration;
+
+		explicit CEventLoopPool(size_t threads = 0) {
+			if (threads == 0) {
+				threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+			}
+			for (size_t i = 0; i < threads; ++i) {
+				workers_.push_back(std::make_unique<Worker>());
+			}
+			// 事件循环在自己的线程上构造，这样它就是那个线程的当前事件循环，不会占用构造线程的。
+			// 事件循环由线程池持有，所有线程退出后才析构，停止过程中别的线程还可以往里投递
+			size_t started = 0;
+			std::mutex startMutex;
+			std::condition_variable startCond;
+			for (size_t i = 0; i < threads; ++i) {
+				workers_[i]->thread = std::thread([this, i, &started, &startMutex, &startCond] {
+					s_currentPool = this;
+					s_workerIndex = i;
+					CEventLoop* loop;
+					{
+						std::lock_guard<std::mutex> lock(startMutex);
+						workers_[i]->loop = std::make_unique<CEventLoop>();
+						loop = workers_[i]->loop.get();
+						++started;
+						startCond.notify_one();// 在锁内通知，构造函数返回后startCond就销毁了
+					}
+					loop->run();
+					s_currentPool = nullptr;
+				});
+			}
+			std::unique_lock<std::mutex> lock(startMutex);
+			startCond.wait(lock, [&] { return started == threads; });
+		}
+		~CEventLoopPool() {
+			assert(s_currentPool != this && "destroy CEventLoopPool in its own worker thread");
+			for (auto& worker : workers_) {
+				worker->loop->stop();
+			}
+			for (auto& worker : workers_) {
+				worker->thread.join();
+			}
+		}
+		CEventLoopPool(const CEventLoopPool&) = delete;
+		CEventLoopPool& operator=(const CEventLoopPool&) = delete;
+
+		size_t size() const { return workers_.size(); }
+		CEventLoop* loop(size_t index) const { return workers_[index]->loop.get(); }
+
+		// 当前线程所属的线程池和工作线程下标，不在线程池的线程里时返回nullptr和invalid_index
+		static CEventLoopPool* currentPool() { return s_currentPool; }
+		static size_t currentWorkerIndex() { return s_currentPool ? s_workerIndex : refl::invalid_index; }
+
+		// 投递到任意一个事件循环
+		void post(Handler handler) {
+			const size_t target = s_currentPool == this ? s_workerIndex : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+			{
+				std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+				workers_[target]->tasks.push_back(std::move(handler));
+			}
+			if (!schedule(target)) {
+				// 目标正在忙，叫醒一个空闲的事件循环来偷
+				for (size_t i = 1; i < workers_.size(); ++i) {
+					const size_t other = (target + i) % workers_.size();
+					if (!workers_[other]->draining.load(std::memory_order_relaxed) && schedule(other)) {
+						break;
+					}
+				}
+			}
+		}
+
+		// 投递到指定的事件循环，不会被别的线程偷走
+		void postTo(size_t index, Handler handler, Duration delay = Duration::zero()) {
+			workers_[index]->loop->post(std::move(handler), delay);
+		}
+
+		// 投递到对象所属的事件循环，对象不属于任何事件循环时和post一样
+		void postTo(const refl::CObject* object, Handler handler, Duration delay = Duration::zero()) {
+			if (CEventLoop* target = object ? object->eventLoop() : nullptr) {
+				target->post(std::move(handler), delay);
+			}
+			else if (delay > Duration::zero()) {
+				postTo(next_.fetch_add(1, std::memory_order_relaxed) % workers_.size(), std::move(handler), delay);
+			}
+			else {
+				post(std::move(handler));
+			}
+		}
+
+		// 把[begin, end)分成若干段并行执行func(i)，执行完才返回。调用线程也参与执行，所以可以在工作线程里调用
+		template <typename Func>
+		void parallelFor(size_t begin, size_t end, Func&& func, size_t grain = 0) {
+			if (begin >= end) {
+				return;
+			}
+			const size_t count = end - begin;
+			if (grain == 0) {
+				grain = std::max<size_t>(1, count / (workers_.size() * 4));
+			}
+			struct State {
+				std::atomic<size_t> next;
+				size_t end;
+				size_t grain;
+				std::atomic<size_t> remaining;
+				std::mutex mutex;
+				std::condition_variable cond;
+			};
+			auto state = std::make_shared<State>();
+			state->next = begin;
+			state->end = end;
+			state->grain = grain;
+			state->remaining = count;
+			auto work = [state, &func] {
+				size_t first;
+				while ((first = state->next.fetch_add(state->grain)) < state->end) {
+					const size_t last = std::min(first + state->grain, state->end);
+					for (size_t i = first; i < last; ++i) {
+						func(i);
+					}
+					if (state->remaining.fetch_sub(last - first) == last - first) {
+						std::lock_guard<std::mutex> lock(state->mutex);
+						state->cond.notify_all();
+					}
+				}
+			};
+			// 没来得及执行的helper在全部完成后才运行，只访问state，不会再调用func
+			const size_t helpers = std::min(workers_.size(), (count + grain - 1) / grain) - (s_currentPool == this ? 1 : 0);
+			for (size_t i = 0; i < helpers; ++i) {
+				post([state, work] {
+					if (state->next.load() < state->end) {
+						work();
+					}
+				});
+			}
+			work();
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->cond.wait(lock, [&] { return state->remaining.load() == 0; });
+		}
+
+	private:
+		static constexpr size_t kDrainBatch = 64;// 每次最多连续执行的任务数，之后让出事件循环处理定时器
+
+		struct Worker {
+			std::unique_ptr<CEventLoop> loop;
+			std::thread thread;
+			std::mutex mutex;
+			std::deque<Handler> tasks;
+			std::atomic<bool> draining{ false };// 已经投递了drain任务
+		};
+
+		// 返回false表示这个事件循环已经在处理队列
+		bool schedule(size_t index) {
+			if (workers_[index]->draining.exchange(true)) {
+				return false;
+			}
+			workers_[index]->loop->post([this, index] { drain(index); });
+			return true;
+		}
+
+		// 先取自己队列的头部，没有再从别的队列尾部偷
+		Handler take(size_t index) {
+			{
+				Worker& worker = *workers_[index];
+				std::lock_guard<std::mutex> lock(worker.mutex);
+				if (!worker.tasks.empty()) {
+					Handler handler = std::move(worker.tasks.front());
+					worker.tasks.pop_front();
+					return handler;
+				}
+			}
+			for (size_t i = 1; i < workers_.size(); ++i) {
+				Worker& victim = *workers_[(index + i) % workers_.size()];
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!victim.tasks.empty()) {
+					Handler handler = std::move(victim.tasks.back());
+					victim.tasks.pop_back();
+					return handler;
+				}
+			}
+			return nullptr;
+		}
+
+		void drain(size_t index) {
+			Worker& worker = *workers_[index];
+			for (size_t count = 0; count < kDrainBatch; ++count) {
+				Handler handler = take(index);
+				if (!handler) {
+					worker.draining.store(false);
+					// 清除标志之前投递到自己队列的任务不会再触发schedule，这里再检查一次
+					bool pending;
+					{
+						std::lock_guard<std::mutex> lock(worker.mutex);
+						pending = !worker.tasks.empty();
+					}
+					if (pending && !worker.draining.exchange(true)) {
+						continue;
+					}
+					return;
+				}
+				handler();
+			}
+			worker.loop->post([this, index] { drain(index); });
+		}
+
+		std::vector<std::unique_ptr<Worker>> workers_;
+		std::atomic<size_t> next_{ 0 };
+
+		static thread_local CEventLoopPool* s_currentPool;
+		static thread_local size_t s_workerIndex;
+	};
+
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+	// 协程帧的分配器：按64字节分级，每个线程缓存释放的帧，下次分配同样大小的帧时直接复用
+	class CCoroutineFrameAllocator {
+	public:
+		static constexpr size_t kGranularity = 64;
+		static constexpr size_t kClasses = 16;// 最大缓存1KB的帧，更大的直接走operator new
+		static constexpr size_t kMaxCached = 256;// 每级最多缓存的帧数
+
+		static void* allocate(size_t size) {
+			const size_t index = classIndex(size);
+			if (index < kClasses) {
+				auto& cache = caches().lists[index];
+				if (!cache.empty()) {
+					void* frame = cache.back();
+					cache.pop_back();
+					return frame;
+				}
+				return ::operator new((index + 1) * kGranularity);
+			}
+			return ::operator new(size);
+		}
+		static void deallocate(void* frame, size_t size) noexcept {
+			const size_t index = classIndex(size);
+			if (index < kClasses) {
+				auto& cache = caches().lists[index];
+				if (cache.size() < cache.capacity() || (cache.size() < kMaxCached && tryReserve(cache))) {
+					cache.push_back(frame);
+					return;
+				}
+			}
+			::operator delete(frame);
+		}
+
+	private:
+		struct Caches {
+			std::vector<void*> lists[kClasses];
+			~Caches() {
+				for (auto& list : lists) {
+					for (void* frame : list) {
+						::operator delete(frame);
+					}
+				}
+			}
+		};
+		static Caches& caches() {
+			thread_local Caches caches;
+			return caches;
+		}
+		static size_t classIndex(size_t size) {
+			return (size + kGranularity - 1) / kGranularity - 1;
+		}
+		static bool tryReserve(std::vector<void*>& cache) noexcept {
+			try {
+				cache.reserve(kMaxCached);
+				return true;
+			}
+			catch (...) {
+				return false;
+			}
+		}
+	};
+
+	// 事件循环上运行的协程的返回类型。协程立即开始执行，结束时自动释放，调用者不需要持有它：
+	//   base::CCoroutine blink(base::CEventLoop& loop) { co_await loop.sleep(1s); ... }
+	class CCoroutine {
+	public:
+		struct promise_type {
+			CCoroutine get_return_object() noexcept { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept { std::terminate(); }
+
+			static void* operator new(size_t size) {
+				return CCoroutineFrameAllocator::allocate(size);
+			}
+			static void operator delete(void* frame, size_t size) noexcept {
+				CCoroutineFrameAllocator::deallocate(frame, size);
+			}
+		};
+	};
+#endif
+
+}// namespace base
+
+namespace refl {
+	inline base::CEventLoop* CObject::current_event_loop() {
+		return base::CEventLoop::currentThreadEventLoop();
+	}
+	inline void CObject::post_to_event_loop(base::CEventLoop* loop, base::CTask task) {
+		loop->postBatched(std::move(task));
+	}
+}// namespace refl
+
+
+#ifdef _WIN32
+#include <Windows.h>
+class CWindowsEventLoopHost : public base::CEventLoop::IEventLoopHost {
+	static constexpr UINT WM_WAKEUP = WM_USER + 15151515;
+	UINT_PTR timerID_ = 0;
+	DWORD threadId_ = GetCurrentThreadId();// 消息循环所在的线程，其他线程post时要唤醒的是它
+
+public:
+	~CWindowsEventLoopHost() {
+		if (timerID_) {
+			KillTimer(NULL, timerID_);
+		}
+	}
+
+	void onPostTask() override {
+		PostThreadMessage(threadId_, WM_WAKEUP, 0, 0);
+	}
+
+	void onWaitForTask(std::condition_variable& cond, std::unique_lock<std::mutex>& locker) override {
+		MSG msg;
+		while (GetMessage(&msg, NULL, 0, 0)) {
+			if (handleWindowsMessage(msg)) {
+				break;
+			}
+			if (cond.wait_for(locker, std::chrono::milliseconds(0), [] { return true; })) {
+				break;
+			}
+		}
+	}
+
+	void onEvent(base::CEventLoop::TaskEventInfo& event) override {
+		event.handler();
+	}
+
+	void onWaitForRun(std::condition_variable& cond, std::unique_lock<std::mutex>& locker, const std::chrono::steady_clock::time_point& timePoint) override {
+		auto now = std::chrono::steady_clock::now();
+		if (now < timePoint) {
+			auto delay_ms = std::chrono::duration_cast<std::chrono::milliseconds>(timePoint - now).count();
+			timerID_ = SetTimer(NULL, 0, (UINT)delay_ms, NULL);//通过timer事件唤醒
+			MSG msg;
+			while (GetMessage(&msg, NULL, 0, 0)) {
+				if (handleWindowsMessage(msg)) {
+					break;
+				}
+			}
+		}
+	}
+
+	void onProcessEvents() override {
+		MSG msg;
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+			if (handleWindowsMessage(msg)) {
+				break;
+			}
+		}
+	}
+
+	bool handleWindowsMessage(MSG& msg) {
+		if (msg.message == WM_QUIT) {
+			if (this->eventLoop) {
+				this->eventLoop->stop();//退出消息循环
+			}
+			return true;
+		}
+		if (msg.message == WM_TIMER && msg.wParam == timerID_) {
+			KillTimer(NULL, timerID_);
+			timerID_ = 0;
+			return true; // Timer event occurred
+		}
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+		return false;
+	}
+};
+#endif // _WIN32
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+// 基于epoll的事件循环宿主：eventfd用于post唤醒，timerfd用于等待下一个定时任务，
+// 另外可以注册文件描述符的就绪回调，一个线程在一次epoll_wait里同时等待socket、定时器和投递的任务
+class CLinuxEventLoopHost : public base::CEventLoop::IEventLoopHost {
+public:
+	using FdCallback = std::function<void(uint32_t events)>;
+
+	CLinuxEventLoopHost() {
+		epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+		wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);// steady_clock在Linux上就是CLOCK_MONOTONIC
+		if (epollFd_ < 0 || wakeupFd_ < 0 || timerFd_ < 0) {
+			closeAll();
+			throw std::runtime_error(std::string("create epoll host failed: ") + std::strerror(errno));
+		}
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = wakeupFd_;
+		epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeupFd_, &event);
+		event.data.fd = timerFd_;
+		epoll_ctl(epollFd_, EPOLL_CTL_ADD, timerFd_, &event);
+	}
+	~CLinuxEventLoopHost() {
+		closeAll();
+	}
+
+	// 注册文件描述符，events为EPOLLIN/EPOLLOUT等，就绪时在事件循环线程中调用callback
+	bool addWatch(int fd, uint32_t events, FdCallback callback) {
+		std::lock_guard<std::mutex> lock(watchesMutex_);
+		epoll_event event{};
+		event.events = events;
+		event.data.fd = fd;
+		if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+			return false;
+		}
+		watches_[fd] = std::make_shared<FdCallback>(std::move(callback));
+		return true;
+	}
+	bool modifyWatch(int fd, uint32_t events) {
+		std::lock_guard<std::mutex> lock(watchesMutex_);
+		epoll_event event{};
+		event.events = events;
+		event.data.fd = fd;
+		return watches_.count(fd) && epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &event) == 0;
+	}
+	void removeWatch(int fd) {
+		std::lock_guard<std::mutex> lock(watchesMutex_);
+		if (watches_.erase(fd)) {
+			epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+		}
+	}
+
+	void onPostTask() override {
+		uint64_t one = 1;
+		ssize_t ret = write(wakeupFd_, &one, sizeof(one));
+		(void)ret;// 计数器满了说明已经有未处理的唤醒，忽略即可
+	}
+
+	void onWaitForTask(std::condition_variable& /*cond*/, std::unique_lock<std::mutex>& locker) override {
+		if (armedTime_ != std::chrono::steady_clock::time_point()) {// 之前设置的截止时间对应的任务可能已经取消，不能再被它唤醒
+			itimerspec spec{};
+			timerfd_settime(timerFd_, 0, &spec, nullptr);
+			armedTime_ = {};
+		}
+		locker.unlock();
+		waitAndDispatch();
+		locker.lock();
+	}
+
+	void onEvent(base::CEventLoop::TaskEventInfo& event) override {
+		event.handler();
+	}
+
+	void onWaitForRun(std::condition_variable& /*cond*/, std::unique_lock<std::mutex>& locker, const std::chrono::steady_clock::time_point& timePoint) override {
+		if (timePoint <= std::chrono::steady_clock::now()) {
+			return;
+		}
+		if (timePoint != armedTime_) {// 截止时间没变时不用重新设置timerfd
+			auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch()).count();
+			itimerspec spec{};
+			spec.it_value.tv_sec = static_cast<time_t>(sinceEpoch / 1000000000);
+			spec.it_value.tv_nsec = static_cast<long>(sinceEpoch % 1000000000);
+			timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+			armedTime_ = timePoint;
+		}
+		locker.unlock();
+		waitAndDispatch();
+		locker.lock();
+	}
+
+	void onProcessEvents() override {
+		waitAndDispatch(0);
+	}
+
+private:
+	void waitAndDispatch(int timeoutMs = -1) {
+		epoll_event events[64];
+		int count = epoll_wait(epollFd_, events, 64, timeoutMs);
+		for (int i = 0; i < count; ++i) {
+			const int fd = events[i].data.fd;
+			if (fd == wakeupFd_ || fd == timerFd_) {
+				uint64_t value;
+				ssize_t ret = read(fd, &value, sizeof(value));
+				(void)ret;
+				if (fd == timerFd_) {
+					armedTime_ = {};
+				}
+				continue;
+			}
+			std::shared_ptr<FdCallback> callback;
+			{
+				std::lock_guard<std::mutex> lock(watchesMutex_);
+				if (auto it = watches_.find(fd); it != watches_.end()) {
+					callback = it->second;
+				}
+			}
+			if (callback) {
+				(*callback)(events[i].events);
+			}
+		}
+	}
+
+	void closeAll() {
+		for (int* fd : { &timerFd_, &wakeupFd_, &epollFd_ }) {
+			if (*fd >= 0) {
+				close(*fd);
+				*fd = -1;
+			}
+		}
+	}
+
+	int epollFd_ = -1;
+	int wakeupFd_ = -1;
+	int timerFd_ = -1;
+	std::chrono::steady_clock::time_point armedTime_{};
+	std::mutex watchesMutex_;
+	std::unordered_map<int, std::shared_ptr<FdCallback>> watches_;
+};
+#endif // __linux__
@@ -0,0 +1,933 @@
+#include "simple_qobject.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// 版本号和构建类型由CMake传入，写在JSON结果里
+#ifndef SIMPLE_QOBJECT_VERSION
+#define SIMPLE_QOBJECT_VERSION "unknown"
+#endif
+#ifndef SIMPLE_QOBJECT_BUILD_TYPE
+#define SIMPLE_QOBJECT_BUILD_TYPE ""
+#endif
+
+// 性能测试用的结构体
+class BenchStruct :
+	public refl::QObject
+{
+public:
+	int x{ 10 };
+	double y{ 20.5 };
+	std::string name{ "bench" };
+
+	int get_x() const {
+		return x;
+	}
+	std::any add_to_x(std::any value) {
+		x += std::any_cast<int>(value);
+		return x;
+	}
+	// 不同参数个数的动态调用
+	std::any add2(std::any a, std::any b) {
+		return x + std::any_cast<int>(a) + std::any_cast<int>(b);
+	}
+	std::any add3(std::any a, std::any b, std::any c) {
+		return x + std::any_cast<int>(a) + std::any_cast<int>(b) + std::any_cast<int>(c);
+	}
+	std::any add4(std::any a, std::any b, std::any c, std::any d) {
+		return x + std::any_cast<int>(a) + std::any_cast<int>(b) + std::any_cast<int>(c) + std::any_cast<int>(d);
+	}
+	void on_value_changed(std::any& value) {
+		x = std::any_cast<int>(value);
+	}
+
+	void on_typed_value_changed(int value) {
+		x = value;
+	}
+	void on_properties_changed(std::any& names) {
+		x += static_cast<int>(std::any_cast<std::vector<std::string_view>&>(names).size());
+	}
+	refl::Signal<int> typed_value_changed;
+
+	void value_changed(std::any value) {
+		REFLEC_IMPL_SIGNAL(value);
+	}
+
+	REFLECTABLE_PROPERTIES(BenchStruct,
+		REFLEC_PROPERTY(x),
+		REFLEC_PROPERTY(y),
+		REFLEC_PROPERTY(name)
+	);
+	REFLECTABLE_MENBER_FUNCS(BenchStruct,
+		REFLEC_FUNCTION(get_x),
+		REFLEC_FUNCTION(add_to_x),
+		REFLEC_FUNCTION(add2),
+		REFLEC_FUNCTION(add3),
+		REFLEC_FUNCTION(add4),
+		REFLEC_FUNCTION(on_value_changed),
+		REFLEC_FUNCTION(on_properties_changed),
+		REFLEC_FUNCTION(value_changed)
+	);
+
+	DECL_DYNAMIC_REFLECTABLE(BenchStruct)
+};
+
+REGEDIT_DYNAMIC_REFLECTABLE(BenchStruct)
+
+namespace {
+	// 防止编译器把被测代码优化掉
+	volatile size_t g_sink = 0;
+	// 统计堆分配次数
+	std::atomic<size_t> g_allocations{ 0 };
+}
+
+void* operator new(size_t size) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::aligned_alloc(static_cast<size_t>(alignment), (size + static_cast<size_t>(alignment) - 1) & ~(static_cast<size_t>(alignment) - 1))) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+	std::free(ptr);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+	std::free(ptr);
+}
+
+namespace {
+
+	// 每项结果输出一行，同时记录下来；指定--json时最后写成JSON文件，用来对比不同版本的性能
+	struct Metric {
+		double value;
+		const char* unit;
+	};
+	struct BenchResult {
+		std::string name;
+		std::vector<Metric> metrics;
+	};
+	std::vector<BenchResult> g_results;
+
+	void report(std::string name, std::initializer_list<Metric> metrics) {
+		std::cout << name << ":";
+		const char* separator = " ";
+		for (const Metric& metric : metrics) {
+			std::cout << separator << metric.value << " " << metric.unit;
+			separator = ", ";
+		}
+		std::cout << std::endl;
+		g_results.push_back(BenchResult{ std::move(name), metrics });
+	}
+
+	// 延迟类的结果看中位数和长尾
+	void report_latency(std::string name, std::vector<double> samples) {
+		std::sort(samples.begin(), samples.end());
+		report(std::move(name), { { samples[samples.size() / 2], "ns (median)" }, { samples[samples.size() * 99 / 100], "ns (p99)" } });
+	}
+
+	template <typename Func>
+	void run_bench(const char* name, size_t iterations, Func&& func) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			func(i);
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		report(name, { { ns / iterations, "ns/op" } });
+	}
+
+	// 在事件循环里每次投递一批任务，执行完再投递下一批，共tasks个，统计每个任务的耗时和堆分配次数。
+	// 第一批用来预热(比如任务节点第一次分配)，不计入
+	template <size_t CaptureSize>
+	void bench_post(const char* name, size_t tasks, std::chrono::nanoseconds delay) {
+		constexpr size_t kWindow = 1000;
+		base::CEventLoop loop;
+		std::array<char, CaptureSize> payload{};
+		size_t executed = 0;
+		size_t posted = 0;
+		size_t allocations = 0;
+		auto start = std::chrono::steady_clock::now();
+		std::function<void()> post_window = [&] {
+			if (posted == kWindow) {
+				start = std::chrono::steady_clock::now();
+				allocations = g_allocations.load();
+			}
+			if (posted == tasks + kWindow) {
+				loop.stop();
+				return;
+			}
+			for (size_t i = 0; i < kWindow; ++i) {
+				loop.post([&executed, payload] {
+					executed += payload[0] + 1;
+					}, delay);
+			}
+			posted += kWindow;
+			loop.post([&post_window] { post_window(); }, delay);
+		};
+		loop.post([&post_window] { post_window(); });
+		loop.run();
+		allocations = g_allocations.load() - allocations;
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		g_sink = g_sink + executed;
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		report(name, { { ns / tasks, "ns/task" }, { double(allocations) / tasks, "allocations/task" } });
+	}
+
+	// 在事件循环里分批投递共tasks个空任务，每批执行完再投递下一批，统计吞吐
+	void bench_throughput(const char* name, size_t tasks, std::chrono::nanoseconds delay) {
+		constexpr size_t kChunk = 10000;
+		base::CEventLoop loop;
+		size_t posted = 0;
+		size_t executed = 0;
+		std::function<void()> seed = [&] {
+			for (size_t i = 0; i < kChunk; ++i) {
+				loop.post([&] {
+					if (++executed == tasks) {
+						loop.stop();
+					}
+					else if (executed == posted) {
+						seed();
+					}
+					}, delay);
+			}
+			posted += kChunk;
+		};
+		auto start = std::chrono::steady_clock::now();
+		loop.post([&] { seed(); });
+		loop.run();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		double seconds = std::chrono::duration<double>(elapsed).count();
+		report(name, { { tasks / seconds / 1e6, "M tasks/s" } });
+	}
+
+	// 序列化的对比基准：手写的JSON，字段用静态反射遍历，对象树递归写入和解析
+	void json_write_string(std::string& out, std::string_view text) {
+		out += '"';
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				out += '\\';
+			}
+			out += c;
+		}
+		out += '"';
+	}
+	template <typename T>
+	void json_write_number(std::string& out, T value) {
+		char buffer[32];
+		out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+	}
+	void json_write_object(std::string& out, const BenchStruct& obj) {
+		out += "{\"type\":";
+		json_write_string(out, BenchStruct::static_type_name());
+		refl::For<BenchStruct>::for_each_propertie_value(const_cast<BenchStruct*>(&obj), [&](const char* name, const auto& value) {
+			out += ',';
+			json_write_string(out, name);
+			out += ':';
+			if constexpr (std::is_same_v<std::decay_t<decltype(value)>, std::string>) {
+				json_write_string(out, value);
+			}
+			else {
+				json_write_number(out, value);
+			}
+			});
+		out += ",\"objectName\":";
+		json_write_string(out, obj.getObjectName());
+		if (const int* index = obj.getProperty<int>("index")) {
+			out += ",\"index\":";
+			json_write_number(out, *index);
+		}
+		out += ",\"children\":[";
+		bool first = true;
+		obj.forEachChild([&](const refl::QObject* child) {
+			if (!first) {
+				out += ',';
+			}
+			first = false;
+			json_write_object(out, *static_cast<const BenchStruct*>(child));
+			});
+		out += "]}";
+	}
+
+	class JsonParser {
+	public:
+		explicit JsonParser(std::string_view text) : p_(text.data()), end_(text.data() + text.size()) {}
+
+		std::shared_ptr<BenchStruct> parse_object(BenchStruct* parent) {
+			expect('{');
+			std::shared_ptr<BenchStruct> obj;
+			do {
+				const std::string key = parse_string();
+				expect(':');
+				if (key == "type") {
+					auto created = refl::internal::TypeRegistry::instance().create(parse_string());
+					obj = std::static_pointer_cast<BenchStruct>(std::static_pointer_cast<refl::CObject>(created));
+				}
+				else if (key == "objectName") {
+					obj->setObjectName(parse_string().c_str());
+				}
+				else if (key == "index") {
+					obj->setProperty("index", parse_number<int>());
+				}
+				else if (key == "children") {
+					if (parent) {
+						obj->setParent(parent);
+					}
+					expect('[');
+					if (*p_ != ']') {
+						do {
+							parse_object(obj.get());
+						} while (accept(','));
+					}
+					expect(']');
+				}
+				else {
+					refl::visit_field(obj.get(), key.c_str(), [&](auto& field) {
+						if constexpr (std::is_same_v<std::decay_t<decltype(field)>, std::string>) {
+							field = parse_string();
+						}
+						else {
+							field = parse_number<std::decay_t<decltype(field)>>();
+						}
+						});
+				}
+			} while (accept(','));
+			expect('}');
+			return obj;
+		}
+
+	private:
+		void expect(char c) {
+			if (p_ == end_ || *p_ != c) {
+				throw std::runtime_error("bad json");
+			}
+			++p_;
+		}
+		bool accept(char c) {
+			if (p_ != end_ && *p_ == c) {
+				++p_;
+				return true;
+			}
+			return false;
+		}
+		std::string parse_string() {
+			expect('"');
+			std::string text;
+			while (p_ != end_ && *p_ != '"') {
+				if (*p_ == '\\') {
+					++p_;
+				}
+				text += *p_++;
+			}
+			expect('"');
+			return text;
+		}
+		template <typename T>
+		T parse_number() {
+			T value{};
+			auto result = std::from_chars(p_, end_, value);
+			if (result.ec != std::errc()) {
+				throw std::runtime_error("bad json");
+			}
+			p_ = result.ptr;
+			return value;
+		}
+
+		const char* p_;
+		const char* end_;
+	};
+
+	std::string compiler_name() {
+#if defined(__clang__)
+		return "clang " __clang_version__;
+#elif defined(__GNUC__)
+		return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+		return "unknown";
+#endif
+	}
+
+	// 构建信息和所有结果，每项结果的指标以单位为键
+	bool write_json_results(const char* path) {
+		std::string out = "{\n  \"version\": ";
+		json_write_string(out, SIMPLE_QOBJECT_VERSION);
+		out += ",\n  \"build_type\": ";
+		json_write_string(out, SIMPLE_QOBJECT_BUILD_TYPE);
+		out += ",\n  \"compiler\": ";
+		json_write_string(out, compiler_name());
+		out += ",\n  \"cxx_standard\": ";
+#ifdef _MSVC_LANG
+		json_write_number(out, static_cast<long>(_MSVC_LANG));
+#else
+		json_write_number(out, static_cast<long>(__cplusplus));
+#endif
+		out += ",\n  \"results\": [";
+		const char* separator = "\n    ";
+		for (const BenchResult& result : g_results) {
+			out += separator;
+			out += "{\"name\": ";
+			json_write_string(out, result.name);
+			for (const Metric& metric : result.metrics) {
+				out += ", ";
+				json_write_string(out, metric.unit);
+				out += ": ";
+				if (std::isfinite(metric.value)) {
+					json_write_number(out, metric.value);
+				}
+				else {
+					out += "null";
+				}
+			}
+			out += '}';
+			separator = ",\n    ";
+		}
+		out += "\n  ]\n}\n";
+		std::ofstream file(path, std::ios::binary);
+		file << out;
+		return static_cast<bool>(file);
+	}
+
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+	// 协程在事件循环上反复挂起和恢复
+	base::CCoroutine bench_switch_to(base::CEventLoop& loop, size_t resumes) {
+		for (size_t i = 0; i < resumes; ++i) {
+			co_await loop.switch_to();
+		}
+		loop.stop();
+	}
+#endif
+}
+
+// 用法：simple_qobject_bench [--json 结果文件]
+int main(int argc, char* argv[]) {
+	const char* json_path = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		}
+		else {
+			std::cerr << "usage: " << argv[0] << " [--json <file>]" << std::endl;
+			return 1;
+		}
+	}
+	constexpr size_t kIterations = 1000000;
+
+	std::shared_ptr<refl::IReflectable> obj = std::make_shared<BenchStruct>();
+
+	std::cout << "---------------------属性读写：" << std::endl;
+	run_bench("get_field_value_by_name", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(obj->get_field_value_by_name("x"));
+		});
+	auto x_handle = refl::PropertyHandle::resolve(obj.get(), "x");
+	run_bench("PropertyHandle::get", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(x_handle.get(obj.get()));
+		});
+	const std::any one = 1;
+	run_bench("PropertyHandle::set", kIterations, [&](size_t) {
+		x_handle.set(obj.get(), one);
+		});
+	auto* bench_struct = static_cast<BenchStruct*>(obj.get());
+	run_bench("assign_field_value (by name)", kIterations, [&](size_t i) {
+		refl::assign_field_value(bench_struct, "x", static_cast<int>(i));
+		});
+	run_bench("assign_field_value_by_index (find_property_index)", kIterations, [&](size_t) {
+		obj->assign_field_value_by_index(obj->find_property_index("x"), one);
+		});
+
+	std::cout << "---------------------动态属性：" << std::endl;
+	{
+		auto object = std::make_shared<BenchStruct>();
+		const char* names[] = { "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel" };
+		for (const char* name : names) {
+			object->setProperty(name, 0);
+		}
+		run_bench("setProperty (8 properties)", kIterations, [&](size_t i) {
+			object->setProperty(names[i % 8], static_cast<int>(i));
+			});
+		run_bench("getProperty<int> (8 properties)", kIterations, [&](size_t i) {
+			g_sink = g_sink + *object->getProperty<int>(names[i % 8]);
+			});
+		object->setProperty("a_rather_long_property_name", 0);
+		run_bench("getProperty<int> (long name)", kIterations, [&](size_t) {
+			g_sink = g_sink + *object->getProperty<int>("a_rather_long_property_name");
+			});
+		run_bench("getProperty (missing)", kIterations, [&](size_t) {
+			g_sink = g_sink + object->getProperty("missing").has_value();
+			});
+		const refl::AtomId delta = refl::QObject::propertyId("delta");
+		run_bench("setProperty by id", kIterations, [&](size_t i) {
+			object->setProperty(delta, static_cast<int>(i));
+			});
+		run_bench("getProperty<int> by id", kIterations, [&](size_t) {
+			g_sink = g_sink + *object->getProperty<int>(delta);
+			});
+	}
+
+	std::cout << "---------------------属性变化通知：" << std::endl;
+	{
+		// 一次批量修改30个属性，有一个观察者
+		auto object = std::make_shared<BenchStruct>();
+		auto observer = std::make_shared<BenchStruct>();
+		object->connect("properties_changed", observer.get(), "on_properties_changed");
+		std::vector<refl::AtomId> ids;
+		for (int i = 0; i < 30; ++i) {
+			ids.push_back(refl::QObject::propertyId(("field_" + std::to_string(i)).c_str()));
+		}
+		constexpr size_t kUpdates = 100000;
+		run_bench("30 property updates, notify each", kUpdates, [&](size_t i) {
+			for (auto id : ids) {
+				object->setProperty(id, static_cast<int>(i));
+			}
+			});
+		run_bench("30 property updates, PropertyUpdateBatch", kUpdates, [&](size_t i) {
+			refl::PropertyUpdateBatch batch;
+			for (auto id : ids) {
+				object->setProperty(id, static_cast<int>(i) + 1);
+			}
+			});
+		run_bench("30 property updates, same values (batch)", kUpdates, [&](size_t) {
+			refl::PropertyUpdateBatch batch;
+			for (auto id : ids) {
+				object->setProperty(id, 7);
+			}
+			});
+	}
+
+	std::cout << "---------------------成员函数调用：" << std::endl;
+	run_bench("invoke_member_func_by_name (0 args)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(obj->invoke_member_func_by_name("get_x"));
+		});
+	run_bench("invoke_member_func_by_name (1 arg)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(obj->invoke_member_func_by_name("add_to_x", one));
+		});
+	run_bench("invoke_member_func_by_name (2 args)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(obj->invoke_member_func_by_name("add2", one, one));
+		});
+	run_bench("invoke_member_func_by_name (3 args)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(obj->invoke_member_func_by_name("add3", one, one, one));
+		});
+	run_bench("invoke_member_func_by_name (4 args)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(obj->invoke_member_func_by_name("add4", one, one, one, one));
+		});
+	// 和上面按名字调用的各个参数个数一一对应，差值就是按名字查找的开销
+	auto get_handle = refl::MethodHandle::resolve<BenchStruct>("get_x");
+	auto add_handle = refl::MethodHandle::resolve<BenchStruct>("add_to_x");
+	auto add2_handle = refl::MethodHandle::resolve<BenchStruct>("add2");
+	auto add3_handle = refl::MethodHandle::resolve<BenchStruct>("add3");
+	auto add4_handle = refl::MethodHandle::resolve<BenchStruct>("add4");
+	run_bench("MethodHandle::invoke (0 args)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(get_handle.invoke(obj.get()));
+		});
+	run_bench("MethodHandle::invoke (1 arg)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(add_handle.invoke(obj.get(), one));
+		});
+	run_bench("MethodHandle::invoke (2 args)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(add2_handle.invoke(obj.get(), one, one));
+		});
+	run_bench("MethodHandle::invoke (3 args)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(add3_handle.invoke(obj.get(), one, one, one));
+		});
+	run_bench("MethodHandle::invoke (4 args)", kIterations, [&](size_t) {
+		g_sink = g_sink + std::any_cast<int>(add4_handle.invoke(obj.get(), one, one, one, one));
+		});
+
+	std::cout << "---------------------信号槽：" << std::endl;
+	for (size_t slot_count : { 1, 10, 1000 }) {
+		auto sender = std::make_shared<BenchStruct>();
+		std::vector<std::shared_ptr<BenchStruct>> receivers;
+		for (size_t i = 0; i < slot_count; ++i) {
+			receivers.push_back(std::make_shared<BenchStruct>());
+			sender->connect("value_changed", receivers.back().get(), "on_value_changed");
+			sender->typed_value_changed.connect(receivers.back(), &BenchStruct::on_typed_value_changed);
+		}
+		std::string name = "emit to " + std::to_string(slot_count) + " slots";
+		run_bench(name.c_str(), kIterations / slot_count, [&](size_t i) {
+			sender->value_changed(static_cast<int>(i));
+			});
+		name = "typed emit to " + std::to_string(slot_count) + " slots";
+		run_bench(name.c_str(), kIterations / slot_count, [&](size_t i) {
+			sender->typed_value_changed.emit(static_cast<int>(i));
+			});
+	}
+
+	std::cout << "---------------------对象树：" << std::endl;
+	{
+		// 5万个对象：根对象下50个分组，每个分组1000个子对象
+		constexpr size_t kGroups = 50;
+		constexpr size_t kChildren = 1000;
+		auto root = std::make_shared<BenchStruct>();
+		std::vector<std::shared_ptr<BenchStruct>> groups;
+		std::vector<std::shared_ptr<BenchStruct>> leaves;
+		std::vector<std::string> leaf_names;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t g = 0; g < kGroups; ++g) {
+			groups.push_back(std::make_shared<BenchStruct>());
+			groups.back()->setObjectName(("group_" + std::to_string(g)).c_str());
+			groups.back()->setParent(root);
+			for (size_t c = 0; c < kChildren; ++c) {
+				leaves.push_back(std::make_shared<BenchStruct>());
+				leaf_names.push_back("node_" + std::to_string(g * kChildren + c));
+				leaves.back()->setObjectName(leaf_names.back().c_str());
+				leaves.back()->setParent(groups.back());
+			}
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		report("build 50k tree", { { std::chrono::duration<double, std::milli>(elapsed).count(), "ms" } });
+		run_bench("findChild (1000 children)", 10000, [&](size_t i) {
+			g_sink = g_sink + (groups[i % kGroups]->findChild(leaf_names[(i % kGroups) * kChildren + i % kChildren].c_str()) != nullptr);
+			});
+		run_bench("findChildRecursively (50k subtree)", 10000, [&](size_t i) {
+			g_sink = g_sink + (root->findChildRecursively(leaf_names[(i * 7919) % leaf_names.size()].c_str()) != nullptr);
+			});
+		run_bench("setObjectName (depth 2)", 10000, [&](size_t i) {
+			leaves[i % leaves.size()]->setObjectName((i & 1) ? "renamed" : leaf_names[i % leaves.size()].c_str());
+			});
+		run_bench("setParent (move leaf between groups)", 10000, [&](size_t i) {
+			leaves[i * 13 % leaves.size()]->setParent(groups[i % kGroups]);
+			});
+	}
+	{
+		// 深的树：1000层的链，每层一个对象
+		constexpr size_t kDepth = 1000;
+		std::vector<std::shared_ptr<BenchStruct>> chain{ std::make_shared<BenchStruct>() };
+		auto start = std::chrono::steady_clock::now();
+		for (size_t d = 1; d < kDepth; ++d) {
+			chain.push_back(std::make_shared<BenchStruct>());
+			chain.back()->setObjectName(("level_" + std::to_string(d)).c_str());
+			chain.back()->setParent(chain[d - 1]);
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		report("build 1000-deep chain", { { std::chrono::duration<double, std::milli>(elapsed).count(), "ms" } });
+		run_bench("findChildRecursively (1000-deep chain, deepest)", 100000, [&](size_t) {
+			g_sink = g_sink + (chain[0]->findChildRecursively("level_999") != nullptr);
+			});
+		run_bench("findChildRecursively (1000-deep chain, from middle)", 100000, [&](size_t) {
+			g_sink = g_sink + (chain[500]->findChildRecursively("level_999") != nullptr);
+			});
+	}
+
+	std::cout << "---------------------对象创建和销毁：" << std::endl;
+	for (int round = 0; round < 4; ++round) {
+		// 10万个对象：根对象下100个分组，每个分组1000个子对象，每个对象一个动态属性。
+		// 前两轮只用来预热内存，避免首次缺页的开销算到其中一方
+		const bool use_arena = round % 2 == 1;
+		constexpr size_t kGroups = 100;
+		constexpr size_t kChildren = 1000;
+		constexpr size_t kNodes = kGroups * kChildren;
+		auto arena = use_arena ? refl::QObjectArena::create() : nullptr;
+		auto make = [&] {
+			return arena ? arena->make<BenchStruct>() : std::make_shared<BenchStruct>();
+		};
+		size_t allocations = g_allocations.load();
+		auto start = std::chrono::steady_clock::now();
+		auto root = make();
+		for (size_t g = 0; g < kGroups; ++g) {
+			auto group = make();
+			group->setParent(root);
+			for (size_t c = 0; c < kChildren; ++c) {
+				auto child = make();
+				child->setProperty("index", static_cast<int>(c));
+				child->setParent(group);
+			}
+		}
+		arena.reset();// 对象持有对象池的引用
+		auto built = std::chrono::steady_clock::now();
+		size_t build_allocations = g_allocations.load() - allocations;
+		root.reset();
+		auto destroyed = std::chrono::steady_clock::now();
+		if (round < 2) {
+			continue;
+		}
+		const std::string suffix = use_arena ? " (QObjectArena)" : " (make_shared)";
+		report("create 100k tree" + suffix, { { std::chrono::duration<double, std::nano>(built - start).count() / kNodes, "ns/object" },
+			{ double(build_allocations) / kNodes, "allocations/object" } });
+		report("destroy 100k tree" + suffix, { { std::chrono::duration<double, std::nano>(destroyed - built).count() / kNodes, "ns/object" } });
+	}
+
+	std::cout << "---------------------按类型名创建：" << std::endl;
+	{
+		// 每种方式创建10万个对象，每1000个释放一次，统计创建加释放的平均耗时
+		constexpr size_t kCreates = 100000;
+		constexpr size_t kBatch = 1000;
+		auto& registry = refl::internal::TypeRegistry::instance();
+		const refl::TypeId type_id = registry.resolve("BenchStruct");
+		std::vector<std::shared_ptr<refl::IReflectable>> objects;
+		objects.reserve(kBatch);
+		auto create_one = [&](auto&& create) {
+			objects.push_back(create());
+			if (objects.size() == kBatch) {
+				objects.clear();
+			}
+		};
+		run_bench("TypeRegistry::create by name", kCreates, [&](size_t) {
+			create_one([&] { return registry.create("BenchStruct"); });
+			});
+		run_bench("TypeRegistry::create by TypeId", kCreates, [&](size_t) {
+			create_one([&] { return registry.create(type_id); });
+			});
+		run_bench("TypeRegistry::create_n", kCreates, [&](size_t i) {
+			if (i % kBatch == 0) {
+				objects.clear();
+				registry.create_n(type_id, kBatch, objects);
+			}
+			});
+		objects.clear();
+		auto arena = refl::QObjectArena::create();
+		run_bench("TypeRegistry::create_n (QObjectArena)", kCreates, [&](size_t i) {
+			if (i % kBatch == 0) {
+				objects.clear();
+				registry.create_n(type_id, kBatch, objects, arena.get());
+			}
+			});
+		objects.clear();
+	}
+
+	std::cout << "---------------------序列化：" << std::endl;
+	{
+		// 2万个对象：根对象下20个分组，每个分组1000个子对象，每个对象三个反射字段、一个动态属性
+		constexpr size_t kGroups = 20;
+		constexpr size_t kChildren = 1000;
+		constexpr size_t kNodes = kGroups * kChildren + kGroups + 1;
+		constexpr int kRounds = 5;
+		auto root = std::make_shared<BenchStruct>();
+		root->setObjectName("root");
+		for (size_t g = 0; g < kGroups; ++g) {
+			auto group = std::make_shared<BenchStruct>();
+			group->setObjectName(("group_" + std::to_string(g)).c_str());
+			group->setParent(root);
+			for (size_t c = 0; c < kChildren; ++c) {
+				auto child = std::make_shared<BenchStruct>();
+				child->x = static_cast<int>(c);
+				child->y = c * 0.25;
+				child->name = "node_" + std::to_string(c);
+				child->setObjectName(("child_" + std::to_string(c)).c_str());
+				child->setProperty("index", static_cast<int>(g * kChildren + c));
+				child->setParent(group);
+			}
+		}
+		auto report_rate = [&](const char* name, std::chrono::steady_clock::duration elapsed, size_t bytes) {
+			const double seconds = std::chrono::duration<double>(elapsed).count() / kRounds;
+			report(name, { { seconds * 1e9 / kNodes, "ns/object" }, { bytes / seconds / 1e6, "MB/s" } });
+		};
+
+		refl::BinaryWriter binary;
+		auto start = std::chrono::steady_clock::now();
+		for (int round = 0; round < kRounds; ++round) {
+			binary.clear();
+			refl::ObjectWriter writer(binary);
+			writer.write(*root);
+		}
+		report_rate("binary write", std::chrono::steady_clock::now() - start, binary.size());
+		start = std::chrono::steady_clock::now();
+		for (int round = 0; round < kRounds; ++round) {
+			refl::BinaryReader in(binary.view());
+			refl::ObjectReader reader(in);
+			g_sink = g_sink + (reader.read()->findChildRecursively("child_999") != nullptr);
+		}
+		report_rate("binary read", std::chrono::steady_clock::now() - start, binary.size());
+
+		std::string json;
+		start = std::chrono::steady_clock::now();
+		for (int round = 0; round < kRounds; ++round) {
+			json.clear();
+			json_write_object(json, *root);
+		}
+		report_rate("json write", std::chrono::steady_clock::now() - start, json.size());
+		start = std::chrono::steady_clock::now();
+		for (int round = 0; round < kRounds; ++round) {
+			JsonParser parser(json);
+			g_sink = g_sink + (parser.parse_object(nullptr)->findChildRecursively("child_999") != nullptr);
+		}
+		report_rate("json read", std::chrono::steady_clock::now() - start, json.size());
+		report("binary size", { { double(binary.size()), "bytes" } });
+		report("json size", { { double(json.size()), "bytes" } });
+
+		// 只编解码反射字段，不创建对象也不维护对象树
+		BenchStruct fields;
+		fields.name = "node_123";
+		refl::BinaryWriter field_out;
+		run_bench("encode_binary (fields only)", kIterations, [&](size_t) {
+			field_out.clear();
+			refl::encode_binary(field_out, fields);
+			});
+		run_bench("decode_binary (fields only)", kIterations, [&](size_t) {
+			refl::BinaryReader in(field_out.view());
+			refl::decode_binary(in, fields);
+			});
+
+		// 快照：映射文件后只创建访问到的对象，和上面读出整棵树对比
+		refl::BinaryWriter snapshot_data;
+		refl::QObjectSnapshot::write(snapshot_data, *root);
+		const char* snapshot_path = "simple_qobject_bench.snapshot";
+		{
+			std::ofstream file(snapshot_path, std::ios::binary);
+			file.write(snapshot_data.data(), snapshot_data.size());
+		}
+		start = std::chrono::steady_clock::now();
+		for (int round = 0; round < kRounds; ++round) {
+			auto snapshot = refl::QObjectSnapshot::open(snapshot_path);
+			g_sink = g_sink + (snapshot->materialize()->findChildRecursively("child_999") != nullptr);
+		}
+		report_rate("snapshot open + findChildRecursively", std::chrono::steady_clock::now() - start, snapshot_data.size());
+		std::function<void(refl::CObject*)> touch_all = [&](refl::CObject* object) {
+			static_cast<refl::QObject*>(object)->forEachChild(touch_all);
+		};
+		start = std::chrono::steady_clock::now();
+		for (int round = 0; round < kRounds; ++round) {
+			auto snapshot = refl::QObjectSnapshot::open(snapshot_path);
+			auto tree = snapshot->materialize();
+			touch_all(tree.get());
+		}
+		report_rate("snapshot open + touch every object", std::chrono::steady_clock::now() - start, snapshot_data.size());
+		report("snapshot size", { { double(snapshot_data.size()), "bytes" } });
+
+		auto snapshot = refl::QObjectSnapshot::open(snapshot_path);
+		const refl::SnapshotNode node = snapshot->root().findChildRecursively("child_999");
+		run_bench("SnapshotNode::findChildRecursively", kIterations / 10, [&](size_t) {
+			g_sink = g_sink + snapshot->root().findChildRecursively("child_500").index();
+			});
+		run_bench("SnapshotNode::get_field_value_by_name", kIterations, [&](size_t) {
+			g_sink = g_sink + std::any_cast<int>(node.get_field_value_by_name("x"));
+			});
+		std::remove(snapshot_path);
+	}
+
+	std::cout << "---------------------定时器：" << std::endl;
+	for (auto type : { base::CEventLoop::TimerType::PreciseTimer, base::CEventLoop::TimerType::CoarseTimer }) {
+		constexpr size_t kTimers = 200000;
+		base::CEventLoop loop;
+		std::vector<base::CEventLoop::CancelHandle> handles(kTimers);
+		const char* suffix = type == base::CEventLoop::TimerType::CoarseTimer ? " (coarse)" : " (precise)";
+		run_bench((std::string("postCancellable") + suffix).c_str(), kTimers, [&](size_t i) {
+			handles[i] = loop.postCancellable([] {}, std::chrono::seconds(30 + i % 600), type);
+			});
+		run_bench((std::string("cancelPostTask") + suffix).c_str(), kTimers, [&](size_t i) {
+			loop.cancelPostTask(handles[i]);
+			});
+	}
+
+	std::cout << "---------------------事件循环任务：" << std::endl;
+	constexpr size_t kTasks = 200000;
+	bench_post<8>("post (16-byte capture)", kTasks, std::chrono::nanoseconds(0));
+	bench_post<32>("post (40-byte capture)", kTasks, std::chrono::nanoseconds(0));
+	bench_post<96>("post (104-byte capture)", kTasks, std::chrono::nanoseconds(0));
+	bench_post<8>("delayed post (16-byte capture)", kTasks, std::chrono::nanoseconds(1));
+	bench_post<32>("delayed post (40-byte capture)", kTasks, std::chrono::nanoseconds(1));
+
+	std::cout << "---------------------事件循环投递吞吐：" << std::endl;
+	bench_throughput("10M trivial posts", 10000000, std::chrono::nanoseconds(0));
+	bench_throughput("10M trivial due timers", 10000000, std::chrono::nanoseconds(1));
+	for (size_t producers : { 1, 4, 16 }) {
+		constexpr size_t kTasks = 1600000;
+		base::CEventLoop loop;
+		size_t executed = 0;// 只在事件循环线程访问
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (size_t p = 0; p < producers; ++p) {
+			threads.emplace_back([&loop, &executed, producers] {
+				for (size_t i = 0; i < kTasks / producers; ++i) {
+					loop.post([&loop, &executed] {
+						if (++executed == kTasks) {
+							loop.stop();
+						}
+						});
+				}
+				});
+		}
+		loop.run();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		report("post from " + std::to_string(producers) + " producers", { { ns / kTasks, "ns/task" } });
+	}
+
+	std::cout << "---------------------事件循环唤醒延迟：" << std::endl;
+	{
+		// 事件循环空闲等待时从其他线程投递任务，统计从投递到开始执行的时间
+		constexpr size_t kSamples = 2000;
+		base::CEventLoop loop;
+		std::thread thread([&loop] { loop.run(); });
+		std::vector<double> latencies;
+		latencies.reserve(kSamples);
+		std::atomic<bool> executed{ false };
+		for (size_t i = 0; i < kSamples; ++i) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));// 让事件循环进入等待
+			executed.store(false, std::memory_order_relaxed);
+			const auto posted = std::chrono::steady_clock::now();
+			loop.post([&latencies, &executed, posted] {
+				latencies.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - posted).count());
+				executed.store(true, std::memory_order_release);
+				});
+			while (!executed.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+		}
+		loop.stop();
+		thread.join();
+		report_latency("cross-thread post wakeup", std::move(latencies));
+	}
+	for (auto type : { base::CEventLoop::TimerType::PreciseTimer, base::CEventLoop::TimerType::CoarseTimer }) {
+		// 定时器反复设置2ms后到期，统计实际执行时间比到期时间晚了多少
+		constexpr size_t kSamples = 300;
+		constexpr auto kDelay = std::chrono::milliseconds(2);
+		base::CEventLoop loop;
+		std::vector<double> lateness;
+		lateness.reserve(kSamples);
+		std::function<void()> schedule = [&] {
+			const auto deadline = std::chrono::steady_clock::now() + kDelay;
+			loop.postCancellable([&, deadline] {
+				lateness.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - deadline).count());
+				if (lateness.size() == kSamples) {
+					loop.stop();
+				}
+				else {
+					schedule();
+				}
+				}, kDelay, type);
+		};
+		loop.post([&] { schedule(); });
+		loop.run();
+		const char* suffix = type == base::CEventLoop::TimerType::CoarseTimer ? " (coarse)" : " (precise)";
+		report_latency(std::string("timer lateness") + suffix, std::move(lateness));
+	}
+
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+	std::cout << "---------------------协程：" << std::endl;
+	{
+		constexpr size_t kResumes = 1000000;
+		base::CEventLoop loop;
+		size_t allocations = g_allocations.load();
+		auto start = std::chrono::steady_clock::now();
+		loop.post([&] { bench_switch_to(loop, kResumes); });
+		loop.run();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		allocations = g_allocations.load() - allocations;
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		report("co_await switch_to", { { ns / kResumes, "ns/resume" }, { double(allocations) / kResumes, "allocations/resume" } });
+	}
+#endif
+	if (json_path && !write_json_results(json_path)) {
+		std::cerr << "cannot write " << json_path << std::endl;
+		return 1;
+	}
+	return 0;
+}
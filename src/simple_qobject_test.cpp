@@ -1,191 +1,414 @@
-
-#include "simple_qobject.h"
-
-// ûԶĽṹ
-class MyStruct :
-	//public refl::dynamic::IReflectable 	// Ҫ̬䣬Բpublic refl::dynamic::IReflectable
-	public refl::QObject // ҲźŲ۵ȹܣ˴
-{
-
-public:
-	~MyStruct() {
-		std::cout << getObjectName() << " destoryed " << std::endl;
-	}
-	int x{ 10 };
-	double y{ 20.5f };
-	int print() const {
-		std::cout << "MyStruct::print called! " << "x: " << x << ", y: " << y << std::endl;
-		return 666;
-	}
-	// Ҫֶ֧̬ãstd::anyҲܳ4
-	int print_with_arg(std::any param) const {
-		std::cout << "MyStruct::print called! " << " arg is: " << std::any_cast<int>(param) << std::endl;
-		return 888;
-	}
-	// һۺREFLECTABLE_MENBER_FUNCSбУֵַ֧Ҳstd::anyܳ4
-	std::any on_x_value_modified(std::any& new_value) {
-		int value = std::any_cast<int>(new_value);
-		std::cout << "MyStruct::on_x_value_modified called! New value is: " << value << std::endl;
-		return 0;
-	}
-
-	void x_value_modified(std::any param) {
-		REFLEC_IMPL_SIGNAL(param);
-	}
-
-	REFLECTABLE_PROPERTIES(MyStruct,
-		REFLEC_PROPERTY(x),
-		REFLEC_PROPERTY(y)
-	);
-	REFLECTABLE_MENBER_FUNCS(MyStruct,
-		REFLEC_FUNCTION(print),
-		REFLEC_FUNCTION(print_with_arg),
-		REFLEC_FUNCTION(on_x_value_modified),
-		REFLEC_FUNCTION(x_value_modified)
-	);
-
-	DECL_DYNAMIC_REFLECTABLE(MyStruct)//̬֧֣Ҫ̬䣬ȥд
-};
-
-//̬ע࣬עᴴ
-REGEDIT_DYNAMIC_REFLECTABLE(MyStruct)
-
-
-int main() {
-
-	// ̬䲿֣
-	std::cout << "---------------------̬䲿֣" << std::endl;
-
-	auto obj = std::make_shared<MyStruct>();
-	// ӡֶ
-	refl::For<MyStruct>::for_each_propertie_name([](const char* name) {
-		std::cout << "Field name: " << name << std::endl;
-		});
-
-	// ӡֵֶ
-	refl::For<MyStruct>::for_each_propertie_value(obj.get(), [](const char* name, auto&& value) {
-		std::cout << "Field " << name << " has value: " << value << std::endl;
-		});
-
-	// ӡк
-	refl::For<MyStruct>::for_each_member_func_name([](const char* name) {
-		std::cout << "Member func name: " << name << std::endl;
-		});
-
-	// ȡضԱֵҲԱ򷵻Ĭֵ
-	auto x_value = refl::get_field_value(obj.get(), "x");
-	std::cout << "Field x has value: " << std::any_cast<int>(x_value) << std::endl;
-
-	auto y_value = refl::get_field_value(obj.get(), "y");
-	std::cout << "Field y has value: " << std::any_cast<double>(y_value) << std::endl;
-
-	//޸ֵ
-	refl::assign_field_value(obj.get(), "y", 33.33f);
-	y_value = refl::get_field_value(obj.get(), "y");
-	std::cout << "Field y has modifyed,new value is: " << std::any_cast<double>(y_value) << std::endl;
-
-	auto z_value = refl::get_field_value(obj.get(), "z"); // "z" 
-	if (z_value.type().name() == std::string_view("int")) {
-		std::cout << "Field z has value: " << std::any_cast<int>(z_value) << std::endl;
-	}
-
-	// ַͨóԱ 'print'
-	auto print_ret = refl::invoke_member_func_safe(obj.get(), "print");
-	std::cout << "print member return: " << std::any_cast<int>(print_ret) << std::endl;
-
-
-	std::cout << "---------------------̬䲿֣" << std::endl;
-
-	// ̬䲿(̬ȫҪ֪MyStructĶ)
-	// ̬ MyStruct ʵ÷
-	auto instance = refl::internal::TypeRegistry::instance().create("MyStruct");
-	if (instance) {
-		std::cout << "Dynamic instance type: " << instance->get_type_name() << std::endl;
-		// Ե MyStruct ĳԱ
-		auto x_value2 = instance->get_field_value_by_name("x");
-		std::cout << "Field x has value: " << std::any_cast<int>(x_value2) << std::endl;
-
-		instance->invoke_member_func_by_name("print");
-		instance->invoke_member_func_by_name("print_with_arg", 10);
-		//instance->invoke_member_func_by_name("print_with_arg", 20, 222);//ûʧܣжԣΪprint_with_argֻһ
-	}
-
-	// źŲ۲֣
-	std::cout << "---------------------źŲ۲֣" << std::endl;
-
-	auto obj1 = std::make_shared<MyStruct>();
-	obj1->setObjectName("obj1");
-	auto obj2 = std::make_shared<MyStruct>();
-	obj2->setObjectName("obj2");
-	obj2->setParent(obj1);
-
-	// obj1źŵobj2Ĳۺ
-	auto connection_id = obj1->connect("x_value_modified", obj2.get(), "on_x_value_modified");
-	if (!connection_id) {
-		std::cout << "Signal x_value_modified from obj1 connected to on_x_value_modified slot in obj2." << std::endl;
-	}
-
-	obj1->x_value_modified(42);// ź
-	// Ͽ
-	obj1->disconnect(connection_id);
-	// ٴδźţӦûκΪѾϿ
-	obj1->x_value_modified(84);
-
-	// ʹóԱָ汾connect
-	connection_id = obj1->connect(&MyStruct::x_value_modified, obj2, &MyStruct::on_x_value_modified);
-	if (!connection_id) {
-		std::cout << "Signal connected to slot." << std::endl;
-	}
-	obj1->x_value_modified(666);// ź
-
-	obj2.reset();
-	obj1.reset();
-
-
-	// ¼ѭ֣
-	std::cout << "---------------------¼ѭ֣" << std::endl;
-	CWindowsEventLoopHost host;
-	base::CEventLoop loop(&host);
-
-	// һÿ봥һεԶʱ
-	auto timerId = loop.startTimer([] {
-		std::cout << "Periodic timer 500ms triggered." << std::endl;
-		}, std::chrono::milliseconds(500));
-
-	loop.post([]() {
-		std::cout << "Immediate task\n";
-		});//ִ
-
-	loop.post([]() {
-		std::cout << "Delayed task\n";
-		}, std::chrono::seconds(1));//ʱһ
-
-	loop.post([]() {
-		std::cout << "Delayed task in 3 second\n";
-		}, std::chrono::seconds(3));//ʱ3
-
-	loop.post([&]() {
-		std::cout << "timer stoped!\n";
-		loop.stopTimer(timerId);
-		}, std::chrono::seconds(4));//ʱ4
-
-	loop.post([&]() {
-		std::cout << "stop msg loop in 8 second\n";
-		loop.stop();
-		}, std::chrono::seconds(8));//ʱ6
-
-	if (true) {
-		loop.run();//ֱ߳run
-	}
-	else {
-		// һ߳run:
-		std::thread loop_thread([&loop]() {
-			loop.run();
-			});
-		std::this_thread::sleep_for(std::chrono::seconds(10));
-		loop.stop();//ֹͣϢѭ
-		loop_thread.join();
-	}
-	std::cout << "====end=====" << std::endl;
-	return 0;
+
+#include "simple_qobject.h"
+#include <future>
+
+// 用户自定义的结构体
+class MyStruct :
+	//public refl::dynamic::IReflectable 	// 如果不需要动态反射，可以不从public refl::dynamic::IReflectable派生
+	public refl::QObject // 这里我们也测试信号槽等功能，因此从这个类派生
+{
+
+public:
+	~MyStruct() {
+		std::cout << getObjectName() << " destoryed " << std::endl;
+	}
+	int x{ 10 };
+	double y{ 20.5f };
+	int print() const {
+		std::cout << "MyStruct::print called! " << "x: " << x << ", y: " << y << std::endl;
+		return 666;
+	}
+	// 如果需要支持动态调用，参数必须是std::any。
+	int print_with_arg(std::any param) const {
+		std::cout << "MyStruct::print called! " << " arg is: " << std::any_cast<int>(param) << std::endl;
+		return 888;
+	}
+	// 定义一个方法，用作槽函数，必须在REFLECTABLE_MENBER_FUNCS列表中，不支持返回值，并且参数必须是std::any。
+	std::any on_x_value_modified(std::any& new_value) {
+		int value = std::any_cast<int>(new_value);
+		std::cout << "MyStruct::on_x_value_modified called! New value is: " << value << std::endl;
+		return 0;
+	}
+
+	void x_value_modified(std::any param) {
+		REFLEC_IMPL_SIGNAL(param);
+	}
+	// 属性变化通知的槽函数，参数是变化的属性名列表
+	void on_properties_changed(std::any& names) {
+		std::cout << getObjectName() << " observed properties changed:";
+		for (auto name : std::any_cast<std::vector<std::string_view>&>(names)) {
+			std::cout << " " << name;
+		}
+		std::cout << std::endl;
+	}
+
+	// 强类型信号，槽函数的参数不需要是std::any，个数也不受限制
+	refl::Signal<double, const std::string&> y_value_modified;
+	void on_y_value_modified(double new_value, const std::string& who) {
+		std::cout << "MyStruct::on_y_value_modified called! New value is: " << new_value << " from " << who << std::endl;
+	}
+
+	REFLECTABLE_PROPERTIES(MyStruct,
+		REFLEC_PROPERTY(x),
+		REFLEC_PROPERTY(y)
+	);
+	REFLECTABLE_MENBER_FUNCS(MyStruct,
+		REFLEC_FUNCTION(print),
+		REFLEC_FUNCTION(print_with_arg),
+		REFLEC_FUNCTION(on_x_value_modified),
+		REFLEC_FUNCTION(on_properties_changed),
+		REFLEC_FUNCTION(x_value_modified)
+	);
+
+	DECL_DYNAMIC_REFLECTABLE(MyStruct)//动态反射的支持，如果不需要动态反射，可以去掉这行代码
+};
+
+//动态反射注册类，注册创建工厂
+REGEDIT_DYNAMIC_REFLECTABLE(MyStruct)
+
+// 多线程信号槽测试用的对象
+std::atomic<int> g_stress_slot_calls{ 0 };
+class StressObject :
+	public refl::QObject
+{
+public:
+	void on_ping(std::any&) {
+		++g_stress_slot_calls;
+	}
+	void on_typed_ping(int) {
+		++g_stress_slot_calls;
+	}
+	void ping(std::any value) {
+		REFLEC_IMPL_SIGNAL(value);
+	}
+	refl::Signal<int> typed_ping;
+
+	REFLECTABLE_PROPERTIES(StressObject);
+	REFLECTABLE_MENBER_FUNCS(StressObject,
+		REFLEC_FUNCTION(on_ping),
+		REFLEC_FUNCTION(ping)
+	);
+
+	DECL_DYNAMIC_REFLECTABLE(StressObject)
+};
+
+REGEDIT_DYNAMIC_REFLECTABLE(StressObject)
+
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+// 用协程按顺序写延时和等待信号，不需要嵌套回调
+base::CCoroutine coroutine_demo(base::CEventLoop& loop, MyStruct* sender) {
+	co_await loop.sleep(std::chrono::milliseconds(1500));
+	std::cout << "coroutine resumed after 1500ms" << std::endl;
+	auto args = co_await sender->next_signal("x_value_modified");
+	std::cout << "coroutine got x_value_modified: " << std::any_cast<int>(args[0]) << std::endl;
+}
+#endif
+
+int main() {
+
+	// 静态反射部分：
+	std::cout << "---------------------静态反射部分：" << std::endl;
+
+	auto obj = std::make_shared<MyStruct>();
+	// 打印所有字段名称
+	refl::For<MyStruct>::for_each_propertie_name([](const char* name) {
+		std::cout << "Field name: " << name << std::endl;
+		});
+
+	// 打印所有字段值
+	refl::For<MyStruct>::for_each_propertie_value(obj.get(), [](const char* name, auto&& value) {
+		std::cout << "Field " << name << " has value: " << value << std::endl;
+		});
+
+	// 打印所有函数名称
+	refl::For<MyStruct>::for_each_member_func_name([](const char* name) {
+		std::cout << "Member func name: " << name << std::endl;
+		});
+
+	// 获取特定成员的值，如果找不到成员，则返回默认值
+	auto x_value = refl::get_field_value(obj.get(), "x");
+	std::cout << "Field x has value: " << std::any_cast<int>(x_value) << std::endl;
+
+	auto y_value = refl::get_field_value(obj.get(), "y");
+	std::cout << "Field y has value: " << std::any_cast<double>(y_value) << std::endl;
+
+	//修改值：
+	refl::assign_field_value(obj.get(), "y", 33.33f);
+	y_value = refl::get_field_value(obj.get(), "y");
+	std::cout << "Field y has modifyed,new value is: " << std::any_cast<double>(y_value) << std::endl;
+
+	auto z_value = refl::get_field_value(obj.get(), "z"); // "z" 不存在
+	if (z_value.type().name() == std::string_view("int")) {
+		std::cout << "Field z has value: " << std::any_cast<int>(z_value) << std::endl;
+	}
+
+	// 通过字符串调用成员函数 'print'
+	auto print_ret = refl::invoke_member_func_safe(obj.get(), "print");
+	std::cout << "print member return: " << std::any_cast<int>(print_ret) << std::endl;
+
+
+	std::cout << "---------------------动态反射部分：" << std::endl;
+
+	// 动态反射部分(动态反射完全不需要知道类型MyStruct的定义)：
+	// 动态创建 MyStruct 实例并调用方法
+	auto instance = refl::internal::TypeRegistry::instance().create("MyStruct");
+	if (instance) {
+		std::cout << "Dynamic instance type: " << instance->get_type_name() << std::endl;
+		// 这里可以调用 MyStruct 的成员方法
+		auto x_value2 = instance->get_field_value_by_name("x");
+		std::cout << "Field x has value: " << std::any_cast<int>(x_value2) << std::endl;
+
+		// 元信息：属性和成员函数按声明顺序排列，可以不经过名字直接遍历
+		const refl::TypeInfo& meta = instance->meta();
+		for (size_t i = 0; i < meta.method_count; ++i) {
+			std::cout << "Dynamic member func: " << meta.methods[i].name << ", arity: " << meta.methods[i].arity << std::endl;
+		}
+
+		instance->invoke_member_func_by_name("print");
+		instance->invoke_member_func_by_name("print_with_arg", 10);
+		//instance->invoke_member_func_by_name("print_with_arg", 20, 222);//这个调用会失败，命中断言，因为print_with_arg只接受一个函数
+	}
+
+	// 从对象池创建：对象和它内部的容器都从对象池的大块内存分配，最后一个对象释放时对象池一起释放
+	{
+		auto arena = refl::QObjectArena::create();
+		auto tree_root = arena->make<MyStruct>();
+		tree_root->setObjectName("arena_root");
+		// 按类型名批量创建时先解析出TypeId，之后不再查找字符串
+		auto& registry = refl::internal::TypeRegistry::instance();
+		const refl::TypeId type_id = registry.resolve("MyStruct");
+		for (int i = 0; i < 3; ++i) {
+			auto child = std::static_pointer_cast<MyStruct>(registry.create(type_id, arena.get()));
+			child->setObjectName(("arena_child_" + std::to_string(i)).c_str());
+			child->setParent(tree_root);
+		}
+		std::cout << "arena_root->findChild(\"arena_child_2\") found: " << (tree_root->findChild("arena_child_2") != nullptr) << std::endl;
+	}
+
+	// 信号槽部分：
+	std::cout << "---------------------信号槽部分：" << std::endl;
+
+	auto obj1 = std::make_shared<MyStruct>();
+	obj1->setObjectName("obj1");
+	auto obj2 = std::make_shared<MyStruct>();
+	obj2->setObjectName("obj2");
+	obj2->setParent(obj1);
+	std::cout << "obj1->findChild(\"obj2\") is obj2: " << (obj1->findChild("obj2") == obj2.get()) << std::endl;
+	obj1->setProperty("speed", 3.5);// 动态属性，按类型直接存取
+	if (const double* speed = obj1->getProperty<double>("speed")) {
+		std::cout << "obj1 dynamic property speed: " << *speed << std::endl;
+	}
+
+	// 二进制序列化：对象树连同对象名、动态属性一起写入，读取时按类型名通过TypeRegistry创建对象
+	{
+		refl::BinaryWriter out;
+		refl::ObjectWriter(out).write(*obj1);
+		refl::BinaryReader in(out.view());
+		auto copy = refl::ObjectReader(in).read();
+		std::cout << "binary copy of obj1: " << out.size() << " bytes, speed: " << *copy->getProperty<double>("speed")
+			<< ", has obj2: " << (copy->findChild("obj2") != nullptr) << std::endl;
+	}
+	// 快照：可以直接映射文件使用，子对象在第一次访问时才创建，定长字段不创建对象也能读取
+	{
+		refl::BinaryWriter out;
+		refl::QObjectSnapshot::write(out, *obj1);
+		auto snapshot = refl::QObjectSnapshot::from_buffer(std::string(out.view()));
+		std::cout << "snapshot of obj1: " << snapshot->node_count() << " nodes, obj2.x read in place: "
+			<< std::any_cast<int>(snapshot->root().findChild("obj2").get_field_value_by_name("x")) << std::endl;
+		auto lazy = snapshot->materialize();
+		std::cout << "lazy copy of obj1 has obj2: " << (lazy->findChild("obj2") != nullptr) << std::endl;
+	}
+
+	// 属性变化通知：赋了不同的值才通知，批量修改合并成一次通知
+	auto property_connection = obj1->connect("properties_changed", obj2.get(), "on_properties_changed");
+	refl::assign_field_value(obj1.get(), "x", 11);// 通知一次：x
+	refl::assign_field_value(obj1.get(), "x", 11);// 值没变，不通知
+	{
+		refl::PropertyUpdateBatch batch;
+		refl::assign_field_value(obj1.get(), "x", 12);
+		refl::assign_field_value(obj1.get(), "y", 1.5);
+		obj1->setProperty("speed", 4.5);
+		refl::assign_field_value(obj1.get(), "x", 13);
+	}// 这里通知一次：x y speed
+	obj1->disconnect(property_connection);
+
+	// 连接obj1的信号到obj2的槽函数
+	auto connection_id = obj1->connect("x_value_modified", obj2.get(), "on_x_value_modified");
+	if (!connection_id) {
+		std::cout << "Signal x_value_modified from obj1 connected to on_x_value_modified slot in obj2." << std::endl;
+	}
+
+	obj1->x_value_modified(42);// 触发信号
+	// 断开连接
+	obj1->disconnect(connection_id);
+	// 再次触发信号，应该没有任何输出，因为已经断开连接
+	obj1->x_value_modified(84);
+
+	// 使用成员函数指针版本的connect
+	connection_id = obj1->connect(&MyStruct::x_value_modified, obj2, &MyStruct::on_x_value_modified);
+	if (!connection_id) {
+		std::cout << "Signal connected to slot." << std::endl;
+	}
+	obj1->x_value_modified(666);// 触发信号
+
+	// 强类型信号的connect
+	auto typed_connection = obj1->y_value_modified.connect(obj2, &MyStruct::on_y_value_modified);
+	obj1->y_value_modified.connect([](double new_value, const std::string&) {
+		std::cout << "lambda slot called! New value is: " << new_value << std::endl;
+		});
+	obj1->y_value_modified.emit(3.14, obj1->getObjectName());
+	obj1->y_value_modified.disconnect(typed_connection);
+	obj1->y_value_modified.emit(6.28, obj1->getObjectName());// 只有lambda会被调用
+
+	obj2.reset();
+	obj1.reset();
+
+	// 多线程信号槽：工作线程不停emit，主线程同时connect/disconnect并析构接收者。可以打开SIMPLE_QOBJECT_ENABLE_TSAN检查数据竞争
+	std::cout << "---------------------多线程信号槽部分：" << std::endl;
+	{
+		auto sender = std::make_shared<StressObject>();
+		// 这个接收者一直连着，保证工作线程emit时始终有槽可调
+		auto live_receiver = std::make_shared<StressObject>();
+		sender->connect("ping", live_receiver.get(), "on_ping");
+		sender->typed_ping.connect(live_receiver, &StressObject::on_typed_ping);
+
+		constexpr int kEmitters = 4;
+		std::atomic<int> ready_emitters{ 0 };
+		std::atomic<bool> start_emit{ false };
+		std::atomic<bool> stop_emit{ false };
+		std::atomic<int64_t> emit_rounds{ 0 };
+		std::vector<std::thread> emitters;
+		for (int i = 0; i < kEmitters; ++i) {
+			emitters.emplace_back([&] {
+				++ready_emitters;
+				while (!start_emit) {// 起跑线：所有线程就绪后一起开始，保证和下面的connect/disconnect重叠
+					std::this_thread::yield();
+				}
+				while (!stop_emit) {
+					sender->ping(1);
+					sender->typed_ping.emit(1);
+					++emit_rounds;
+				}
+				});
+		}
+		while (ready_emitters != kEmitters) {
+			std::this_thread::yield();
+		}
+		start_emit = true;
+		for (int round = 0; round < 2000; ++round) {
+			// 每16轮等工作线程真正emit过再继续修改连接，单核机器上主线程不让出CPU的话工作线程根本跑不起来
+			if (round % 16 == 0) {
+				const int64_t emitted = emit_rounds;
+				while (emit_rounds == emitted) {
+					std::this_thread::yield();
+				}
+			}
+			auto receiver = std::make_shared<StressObject>();
+			auto connection = sender->connect("ping", receiver.get(), "on_ping");
+			auto typed_connection = sender->typed_ping.connect(receiver, &StressObject::on_typed_ping);
+			if (round % 2 == 0) {// 奇数轮不断开，直接析构接收者
+				sender->disconnect(connection);
+				sender->typed_ping.disconnect(typed_connection);
+			}
+		}
+		stop_emit = true;
+		for (auto& emitter : emitters) {
+			emitter.join();
+		}
+		std::cout << "stress test finished, slot calls: " << g_stress_slot_calls << std::endl;
+		if (g_stress_slot_calls == 0) {// 不用assert，Release下也要检查
+			std::cerr << "stress test failed: no slot was called while connecting and disconnecting" << std::endl;
+			return 1;
+		}
+	}
+
+	// 事件循环线程池：parallelFor把区间分段交给各个线程执行；postTo投递到指定的事件循环
+	std::cout << "---------------------事件循环线程池部分：" << std::endl;
+	{
+		base::CEventLoopPool pool(4);
+		std::vector<int> squares(1000);
+		pool.parallelFor(0, squares.size(), [&squares](size_t i) {
+			squares[i] = static_cast<int>(i * i);
+			});
+		std::cout << "squares[999] = " << squares[999] << std::endl;
+
+		std::promise<size_t> worker;
+		pool.postTo(1, [&worker] {
+			worker.set_value(base::CEventLoopPool::currentWorkerIndex());
+			});
+		std::cout << "task pinned to worker " << worker.get_future().get() << std::endl;
+	}
+
+
+	// 事件循环部分：
+	std::cout << "---------------------事件循环部分：" << std::endl;
+#if defined(_WIN32)
+	CWindowsEventLoopHost host;
+	base::CEventLoop loop(&host);
+#elif defined(__linux__)
+	CLinuxEventLoopHost host;
+	base::CEventLoop loop(&host);
+#else
+	base::CEventLoop loop;
+#endif
+
+	// 跨线程的信号：接收者在事件循环的线程上构造，属于loop；在工作线程emit时，默认的AutoConnection会把槽函数投递到loop中执行
+	auto queued_sender = std::make_shared<MyStruct>();
+	auto queued_receiver = std::make_shared<MyStruct>();
+	queued_receiver->setObjectName("queued_receiver");
+	queued_sender->connect("x_value_modified", queued_receiver.get(), "on_x_value_modified");
+	std::thread worker([queued_sender] {
+		queued_sender->x_value_modified(2024);
+		});
+	worker.join();
+
+	// 启动一个每秒触发一次的周期性定时器
+	auto timerId = loop.startTimer([] {
+		std::cout << "Periodic timer 500ms triggered." << std::endl;
+		}, std::chrono::milliseconds(500));
+
+	loop.post([]() {
+		std::cout << "Immediate task\n";
+		});//马上执行
+
+	loop.post([]() {
+		std::cout << "Delayed task\n";
+		}, std::chrono::seconds(1));//延时一秒
+
+	loop.post([]() {
+		std::cout << "Delayed task in 3 second\n";
+		}, std::chrono::seconds(3));//延时3秒
+
+	loop.post([&]() {
+		std::cout << "timer stoped!\n";
+		loop.stopTimer(timerId);
+		}, std::chrono::seconds(4));//延时4秒
+
+#if SIMPLE_QOBJECT_HAS_COROUTINES
+	auto coroutine_sender = std::make_shared<MyStruct>();
+	coroutine_demo(loop, coroutine_sender.get());
+	loop.post([coroutine_sender]() {
+		coroutine_sender->x_value_modified(2025);
+		}, std::chrono::seconds(2));
+#endif
+
+	loop.post([&]() {
+		std::cout << "stop msg loop in 8 second\n";
+		loop.stop();
+		}, std::chrono::seconds(8));//延时6秒
+
+	if (true) {
+		loop.run();//主线程直接run
+	}
+	else {
+		// 或者起一个其他线程run:
+		std::thread loop_thread([&loop]() {
+			loop.run();
+			});
+		std::this_thread::sleep_for(std::chrono::seconds(10));
+		loop.stop();//停止消息循环
+		loop_thread.join();
+	}
+	std::cout << "====end=====" << std::endl;
+	return 0;
 }
\ No newline at end of file